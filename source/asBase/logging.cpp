@@ -1,27 +1,300 @@
 #include "logging.h"
 
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
 namespace asBase
 {
+constexpr size_t g_logSlotCount = 1024;		// power of two
+constexpr size_t g_logTextSize = 480;
+constexpr int g_logIdleMilliseconds = 5;	// the output thread polls, real-time threads cannot notify it
+
+struct LogSlot
+{
+	std::atomic<size_t> sequence;
+	size_t position;
+	LogLevel level;
+	const char* function;
+	int line;
+	bool hasFrame;
+	uint64_t frame;
+	std::chrono::system_clock::time_point time;
+	size_t size;
+	char text[g_logTextSize];
+};
+
+namespace
+{
+	thread_local bool g_realtimeThread = false;
+	thread_local bool g_hasFrame = false;
+	thread_local uint64_t g_frame = 0;
+
+	std::atomic<int> g_logLevel{LogInfo};
 
 #ifdef _WIN32
+	void g_logWin32(const char* _s)
+	{
+		OutputDebugStringA(_s);
+		fputs(_s, stdout);
+	}
+#else
+	void g_logUnix(const char* _s)
+	{
+		fputs(_s, stdout);
+	}
+#endif
 
-#define WIN32_LEAN_AND_MEAN
-#include <Windows.h>
+	// Bounded lock-free queue for any number of producers and one consumer. Every slot has a sequence number that tells
+	// whether it is free for the producer at a position or holds a message for the consumer
+	class Logger
+	{
+	public:
+		Logger() : m_slots(new LogSlot[g_logSlotCount])
+		{
+			for(size_t i=0; i<g_logSlotCount; ++i)
+				m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+			m_thread = std::thread(&Logger::threadFunc, this);
+		}
+
+		~Logger()
+		{
+			m_stop = true;
+			m_thread.join();
+		}
+
+		LogSlot* claim()
+		{
+			auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+			while(true)
+			{
+				auto& slot = m_slots[pos & (g_logSlotCount - 1)];
+				const auto diff = static_cast<intptr_t>(slot.sequence.load(std::memory_order_acquire)) - static_cast<intptr_t>(pos);
+
+				if(diff == 0)
+				{
+					if(m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					{
+						slot.position = pos;
+						return &slot;
+					}
+				}
+				else if(diff < 0)
+				{
+					return nullptr;	// full
+				}
+				else
+				{
+					pos = m_enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		static void publish(LogSlot& _slot)
+		{
+			_slot.sequence.store(_slot.position + 1, std::memory_order_release);
+		}
+
+		void drop()
+		{
+			m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+			m_unreportedDropCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void flush() const
+		{
+			const auto pos = m_enqueuePos.load(std::memory_order_relaxed);
+
+			while(m_dequeuePos.load(std::memory_order_acquire) < pos)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+			fflush(stdout);
+		}
+
+		uint64_t getDropCount() const
+		{
+			return m_droppedCount.load(std::memory_order_relaxed);
+		}
+
+	private:
+		void threadFunc()
+		{
+			while(true)
+			{
+				const auto stop = m_stop.load();
+
+				if(!writeMessages() && stop)
+					return;
+
+				const auto dropped = m_unreportedDropCount.exchange(0, std::memory_order_relaxed);
+
+				if(dropped)
+				{
+					char line[64];
+					snprintf(line, sizeof(line), "Warning: %" PRIu64 " log messages have been dropped\n", dropped);
+					output(line);
+				}
+
+				fflush(stdout);
+
+				if(!stop)
+					std::this_thread::sleep_for(std::chrono::milliseconds(g_logIdleMilliseconds));
+			}
+		}
+
+		// returns false if there was nothing to write
+		bool writeMessages()
+		{
+			auto pos = m_dequeuePos.load(std::memory_order_relaxed);
+			const auto first = pos;
+
+			while(true)
+			{
+				auto& slot = m_slots[pos & (g_logSlotCount - 1)];
+
+				if(slot.sequence.load(std::memory_order_acquire) != pos + 1)
+					break;
+
+				write(slot);
+
+				slot.sequence.store(pos + g_logSlotCount, std::memory_order_release);
+				m_dequeuePos.store(++pos, std::memory_order_release);
+			}
+
+			return pos != first;
+		}
+
+		static void write(const LogSlot& _slot)
+		{
+			static const char* const levels[] = { "Debug: ", "", "Warning: ", "Error: " };
+
+			const auto time = std::chrono::system_clock::to_time_t(_slot.time);
+			const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(_slot.time.time_since_epoch()).count() % 1000;
+
+			tm local;
+#ifdef _WIN32
+			localtime_s(&local, &time);
+#else
+			localtime_r(&time, &local);
+#endif
+			char frame[32] = "";
+
+			if(_slot.hasFrame)
+				snprintf(frame, sizeof(frame), " [%" PRIu64 "]", _slot.frame);
+
+			char line[g_logTextSize + 256];
+
+			snprintf(line, sizeof(line), "%02d:%02d:%02d.%03d%s %s@%d: %s%.*s\n", local.tm_hour, local.tm_min, local.tm_sec, static_cast<int>(ms),
+				frame, _slot.function, _slot.line, levels[_slot.level], static_cast<int>(_slot.size), _slot.text);
+
+			output(line);
+		}
+
+		static void output(const char* _line)
+		{
+#ifdef _WIN32
+			g_logWin32(_line);
+#else
+			g_logUnix(_line);
+#endif
+		}
 
-void g_logWin32(const std::string& _s )
+		std::unique_ptr<LogSlot[]> m_slots;
+
+		std::atomic<size_t> m_enqueuePos{0};
+		std::atomic<size_t> m_dequeuePos{0};
+
+		std::atomic<uint64_t> m_droppedCount{0};
+		std::atomic<uint64_t> m_unreportedDropCount{0};
+
+		std::atomic<bool> m_stop{false};
+		std::thread m_thread;
+	};
+
+	Logger& getLogger()
+	{
+		static Logger logger;
+		return logger;
+	}
+}
+
+void setLogLevel(const LogLevel _level)
 {
-	OutputDebugStringA( (_s + "\n").c_str() );
-	puts(_s.c_str());
+	g_logLevel = _level;
 }
 
-#else
+bool isLogEnabled(const LogLevel _level)
+{
+	return _level >= g_logLevel.load(std::memory_order_relaxed);
+}
 
-void g_logUnix(const std::string& _s )
+void setLogRealtimeThread(const bool _realtime)
 {
-	puts(_s.c_str());
-//	fputs(_s.c_str(), stderr);auto
+	getLogger();	// make sure that the logger exists before the real-time thread uses it
+	g_realtimeThread = _realtime;
 }
 
-#endif
-		
+void setLogFramePosition(const uint64_t _frame)
+{
+	g_hasFrame = true;
+	g_frame = _frame;
+}
+
+void flushLog()
+{
+	getLogger().flush();
+}
+
+uint64_t getLogDropCount()
+{
+	return getLogger().getDropCount();
+}
+
+LogRecord::LogRecord(const LogLevel _level, const char* _function, const int _line) : m_slot(nullptr), m_stream(&m_buffer)
+{
+	auto& logger = getLogger();
+
+	m_slot = logger.claim();
+
+	while(!m_slot)
+	{
+		if(g_realtimeThread)
+		{
+			logger.drop();
+			return;
+		}
+
+		std::this_thread::yield();
+		m_slot = logger.claim();
+	}
+
+	m_slot->level = _level;
+	m_slot->function = _function;
+	m_slot->line = _line;
+	m_slot->hasFrame = g_hasFrame;
+	m_slot->frame = g_frame;
+	m_slot->time = std::chrono::system_clock::now();
+
+	m_buffer.set(m_slot->text, g_logTextSize);
+}
+
+LogRecord::~LogRecord()
+{
+	if(!m_slot)
+		return;
+
+	m_slot->size = m_buffer.size();
+	Logger::publish(*m_slot);
+}
 }
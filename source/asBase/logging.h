@@ -1,26 +1,78 @@
 #pragma once
 
-#include <sstream>
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
 
 namespace asBase
 {
+	enum LogLevel
+	{
+		LogDebug,
+		LogInfo,
+		LogWarning,
+		LogError,
+	};
 
-#ifdef _WIN32
-	void g_logWin32( const std::string& _s );
+	// Messages are formatted into preallocated records of a fixed size and written to stdout by a background thread.
+	// Logging does not allocate memory and does not wait for the output. If all records are in use, real-time threads drop
+	// the message and the number of dropped messages is reported later, other threads wait for a free record
+	void setLogLevel(LogLevel _level);
+	bool isLogEnabled(LogLevel _level);
 
-	#define DO_LOG(ss)	{ asBase::g_logWin32( (ss).str() ); }
-#else
-	void g_logUnix( const std::string& _s );
+	// the calling thread never waits for a free record
+	void setLogRealtimeThread(bool _realtime);
 
-	#define DO_LOG(ss)		{ asBase::g_logUnix( (ss).str() ); }
-#endif
+	// the messages of the calling thread are stamped with this audio frame position
+	void setLogFramePosition(uint64_t _frame);
 
-#define LOG(S)																												\
+	// returns once all messages that have been logged so far are written
+	void flushLog();
+
+	uint64_t getLogDropCount();
+
+	struct LogSlot;
+
+	// one message, it is handed over to the output thread when this is destroyed
+	class LogRecord
+	{
+	public:
+		LogRecord(LogLevel _level, const char* _function, int _line);
+		LogRecord(const LogRecord&) = delete;
+		LogRecord& operator = (const LogRecord&) = delete;
+		~LogRecord();
+
+		explicit operator bool() const	{ return m_slot != nullptr; }
+		std::ostream& stream()			{ return m_stream; }
+
+	private:
+		// writes into the text of the record, the message is truncated if it does not fit
+		class Buffer : public std::streambuf
+		{
+		public:
+			void set(char* _begin, size_t _size)	{ setp(_begin, _begin + _size); }
+			size_t size() const						{ return static_cast<size_t>(pptr() - pbase()); }
+		};
+
+		LogSlot* m_slot;
+		Buffer m_buffer;
+		std::ostream m_stream;
+	};
+
+#define LOG_LEVEL(L, S)																										\
 {																															\
-	std::stringstream ss;	ss << __FUNCTION__ << "@" << __LINE__ << ": " << S;												\
-																															\
-	DO_LOG(ss)																											\
+	if(asBase::isLogEnabled(L))																								\
+	{																														\
+		asBase::LogRecord logRecord(L, __FUNCTION__, __LINE__);																\
+		if(logRecord)																										\
+			logRecord.stream() << S;																						\
+	}																														\
 }
 
+#define LOG(S)			LOG_LEVEL(asBase::LogInfo, S)
+#define LOG_DEBUG(S)	LOG_LEVEL(asBase::LogDebug, S)
+#define LOG_WARNING(S)	LOG_LEVEL(asBase::LogWarning, S)
+#define LOG_ERROR(S)	LOG_LEVEL(asBase::LogError, S)
+
 }
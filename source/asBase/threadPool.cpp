@@ -0,0 +1,194 @@
+#include "threadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace asBase
+{
+ThreadPool::ThreadPool(const size_t _threadCount, const size_t _maxQueueSize) : m_maxQueueSize(std::max(static_cast<size_t>(1), _maxQueueSize))
+{
+	const auto threadCount = std::max(static_cast<size_t>(1), _threadCount);
+
+	m_threads.reserve(threadCount);
+
+	for(size_t i=0; i<threadCount; ++i)
+		m_threads.emplace_back(&ThreadPool::threadFunc, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cvIdle.wait(lock, [this] { return m_jobs.empty() && m_runningJobs == 0; });
+		m_stop = true;
+	}
+
+	m_cvJobAvailable.notify_all();
+
+	for(auto& thread : m_threads)
+		thread.join();
+}
+
+void ThreadPool::push(Job _job)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cvSpaceAvailable.wait(lock, [this] { return m_jobs.size() < m_maxQueueSize; });
+		m_jobs.emplace_back(std::move(_job));
+	}
+
+	m_cvJobAvailable.notify_one();
+}
+
+bool ThreadPool::tryPush(Job _job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_jobs.size() >= m_maxQueueSize)
+			return false;
+		m_jobs.emplace_back(std::move(_job));
+	}
+
+	m_cvJobAvailable.notify_one();
+	return true;
+}
+
+void ThreadPool::parallelFor(const size_t _count, const std::function<void(size_t)>& _func)
+{
+	struct State
+	{
+		std::function<void(size_t)> func;
+		size_t count = 0;
+		std::atomic<size_t> next{0};
+		size_t done = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable cvDone;
+	};
+
+	auto state = std::make_shared<State>();
+	state->func = _func;
+	state->count = _count;
+
+	// helpers that start after all items have been taken return immediately, we never wait for a job that did not start
+	auto work = [](State& _state)
+	{
+		size_t completed = 0;
+		std::exception_ptr error;
+
+		for(auto i = _state.next++; i < _state.count; i = _state.next++, ++completed)
+		{
+			try
+			{
+				_state.func(i);
+			}
+			catch(...)
+			{
+				if(!error)
+					error = std::current_exception();
+			}
+		}
+
+		if(!completed)
+			return;
+
+		std::lock_guard<std::mutex> lock(_state.mutex);
+
+		if(error && !_state.error)
+			_state.error = error;
+
+		_state.done += completed;
+
+		if(_state.done == _state.count)
+			_state.cvDone.notify_all();
+	};
+
+	const auto helperCount = std::min(m_threads.size(), _count) - (_count > 0 ? 1 : 0);
+
+	for(size_t i=0; i<helperCount; ++i)
+	{
+		if(!tryPush([state, work] { work(*state); }))
+			break;
+	}
+
+	work(*state);
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cvDone.wait(lock, [&state] { return state->done == state->count; });
+
+	if(state->error)
+		std::rethrow_exception(state->error);
+}
+
+void ThreadPool::waitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_cvIdle.wait(lock, [this] { return m_jobs.empty() && m_runningJobs == 0; });
+
+	if(m_error)
+	{
+		auto error = m_error;
+		m_error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+size_t ThreadPool::getQueueSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_jobs.size();
+}
+
+void ThreadPool::threadFunc()
+{
+	while(true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_cvJobAvailable.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+
+			if(m_jobs.empty())
+				return;	// stopped
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+			++m_runningJobs;
+		}
+
+		m_cvSpaceAvailable.notify_one();
+
+		std::exception_ptr error;
+
+		try
+		{
+			job();
+		}
+		catch(...)
+		{
+			error = std::current_exception();
+		}
+
+		// release whatever the job holds before reporting completion
+		job = nullptr;
+
+		bool idle;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if(error && !m_error)
+				m_error = error;
+
+			--m_runningJobs;
+			idle = m_jobs.empty() && m_runningJobs == 0;
+		}
+
+		if(idle)
+			m_cvIdle.notify_all();
+	}
+}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace asBase
+{
+	// Fixed number of worker threads processing jobs from a bounded queue.
+	// push() blocks if the queue is full to apply backpressure to the producer
+	class ThreadPool
+	{
+	public:
+		typedef std::function<void()> Job;
+
+		ThreadPool(size_t _threadCount, size_t _maxQueueSize);
+		ThreadPool(const ThreadPool&) = delete;
+		~ThreadPool();
+
+		void push(Job _job);
+		bool tryPush(Job _job);
+
+		// calls _func for every index in [0, _count) and returns once all calls are done. The calling thread processes
+		// items as well, helper jobs are only enqueued if there is space. Can be called from within a job of this pool
+		void parallelFor(size_t _count, const std::function<void(size_t)>& _func);
+
+		// blocks until all jobs have been processed. Rethrows the first exception that has been thrown by a job, if any
+		void waitIdle();
+
+		size_t getQueueSize() const;
+		size_t getThreadCount() const		{ return m_threads.size(); }
+		size_t getMaxQueueSize() const		{ return m_maxQueueSize; }
+
+		ThreadPool& operator = (const ThreadPool&) = delete;
+
+	private:
+		void threadFunc();
+
+		std::vector<std::thread> m_threads;
+
+		std::deque<Job> m_jobs;
+		const size_t m_maxQueueSize;
+		size_t m_runningJobs = 0;
+		bool m_stop = false;
+
+		std::exception_ptr m_error;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_cvJobAvailable;
+		std::condition_variable m_cvSpaceAvailable;
+		std::condition_variable m_cvIdle;
+	};
+}
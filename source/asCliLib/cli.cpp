@@ -2,11 +2,16 @@
 
 
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 
 #include "../asLib/autosampler.h"
 #include "../asLib/error.h"
+#include "../asLib/filenameTemplate.h"
+#include "../asLib/flacWriter.h"
+#include "../asLib/offlineSlicer.h"
+#include "../asLib/session.h"
 
 namespace asCli
 {
@@ -60,6 +65,123 @@ template <> std::vector<uint8_t> parse<std::vector<uint8_t>>(const std::string&
 	return target;
 }
 
+template <> std::vector<asLib::ChannelMapping> parse<std::vector<asLib::ChannelMapping>>(const std::string& _input)
+{
+	// midiChannel:firstInput-lastInput, separated by commas
+	std::vector<asLib::ChannelMapping> target;
+
+	std::istringstream ssCommas(_input);
+
+	std::string sCommas;
+
+	while(std::getline(ssCommas,sCommas,','))
+	{
+		if(sCommas.empty())
+			continue;
+
+		int channel, first, last;
+		char colon, minus;
+
+		std::istringstream ssMapping(sCommas);
+
+		if(!(ssMapping >> channel >> colon >> first) || colon != ':')
+			throw std::runtime_error((std::string("Invalid channel mapping ") + sCommas + ", expected form midichannel:input or midichannel:firstinput-lastinput").c_str());
+
+		if(ssMapping >> minus)
+		{
+			if(minus != '-' || !(ssMapping >> last))
+				throw std::runtime_error((std::string("Invalid channel mapping ") + sCommas + ", expected form midichannel:input or midichannel:firstinput-lastinput").c_str());
+		}
+		else
+		{
+			last = first;
+		}
+
+		asLib::ChannelMapping mapping;
+		mapping.midiChannel = static_cast<uint8_t>(channel);
+		mapping.firstInputChannel = std::min(first, last);
+		mapping.inputChannelCount = std::abs(last - first) + 1;
+
+		if(channel < 0 || channel > 15)
+			throw std::runtime_error("MIDI channels of the channel map must be in range 0-15");
+		if(mapping.firstInputChannel < 0)
+			throw std::runtime_error("Input channels of the channel map must not be negative");
+
+		for(const auto& m : target)
+		{
+			if(m.midiChannel == mapping.midiChannel)
+				throw std::runtime_error("Each MIDI channel can only be mapped once");
+		}
+
+		target.push_back(mapping);
+	}
+
+	return target;
+}
+
+template <> std::vector<asLib::DevicePair> parse<std::vector<asLib::DevicePair>>(const std::string& _input)
+{
+	// audioinput|midioutput, separated by semicolons as device names may contain commas
+	std::vector<asLib::DevicePair> target;
+
+	std::istringstream ssSemis(_input);
+
+	std::string sSemis;
+
+	while(std::getline(ssSemis,sSemis,';'))
+	{
+		if(sSemis.empty())
+			continue;
+
+		const auto pos = sSemis.find('|');
+
+		if(pos == std::string::npos)
+			throw std::runtime_error((std::string("Invalid device ") + sSemis + ", expected form audioinput|midioutput").c_str());
+
+		asLib::DevicePair device;
+		device.inputDevice = sSemis.substr(0, pos);
+		device.midiOutputDevice = sSemis.substr(pos + 1);
+
+		target.push_back(device);
+	}
+
+	return target;
+}
+
+template <> asLib::FileIO parse<asLib::FileIO>(const std::string& _input)
+{
+	auto in(_input);
+	std::transform(in.begin(), in.end(), in.begin(), ::tolower);
+
+	if(in == "stdio")
+		return asLib::FileIOStdio;
+	if(in == "vectored")
+		return asLib::FileIOVectored;
+	if(in == "direct")
+		return asLib::FileIODirect;
+	if(in == "uring")
+		return asLib::FileIOUring;
+
+	throw std::runtime_error((std::string("Invalid file I/O mode ") + _input + ", expected stdio, vectored, direct or uring").c_str());
+}
+
+template <> asBase::LogLevel parse<asBase::LogLevel>(const std::string& _input)
+{
+	auto in(_input);
+	std::transform(in.begin(), in.end(), in.begin(), ::tolower);
+
+	if(in == "debug")
+		return asBase::LogDebug;
+	if(in == "info")
+		return asBase::LogInfo;
+	if(in == "warning")
+		return asBase::LogWarning;
+	if(in == "error")
+		return asBase::LogError;
+
+	throw std::runtime_error((std::string("Invalid log level ") + _input + ", expected debug, info, warning or error").c_str());
+}
+
 Cli::Cli(int argc, char* argv[]) : m_commandLine(argc, argv)
 {
 }
@@ -82,26 +204,58 @@ int Cli::run()
 		registerArgument("mo-device", m_config.midiOutputDevice, "Specify the MIDI device to be used to send midi data. Can be empty in which case the default device is used", true, {"MIDIOUT2 (BCR2000)"});
 		registerArgument("mo-api", m_config.midiOutputApi, "Specify the MIDI host API to be used. Can be empty in which case the default api is used. On some systems, for example on Windows, there is only one API anyway.", true, {"MMSystem"});
 
+		registerArgument("devices", m_config.devices, "Sample multiple devices in parallel, each one records all notes. Specify a semicolon separated list of audioinput|midioutput pairs, ai-device and mo-device are ignored if specified. The filename needs to contain {device}.", true, {"Input 1-2 (Interface A)|MIDIOUT2 (BCR2000);Input 1-2 (Interface B)|MIDIOUT3 (BCR2000)"});
+
+		registerArgument("virtual-instrument", m_config.virtualInstrument, "Record a built-in software instrument instead of using audio input and MIDI output devices. Runs faster than real time and produces the same results on every run, useful to test and profile a session without hardware.", true, {"1","0"});
+		registerArgument("vi-attack", m_config.virtualAttack, "Attack time in seconds of the virtual instrument.", true, {"0.01","0.2"});
+		registerArgument("vi-decay", m_config.virtualDecay, "Time in seconds until a note of the virtual instrument has decayed by 60 dB after it has been released.", true, {"0.5","3.0"});
+		registerArgument("vi-noise", m_config.virtualNoise, "Noise level of the virtual instrument in range 0-1.", true, {"0","0.001"});
+
 		registerArgument("midi-notes", m_config.noteNumbers, "Specify the MIDI notes to be played. Can be specified as a single note", true, {"60", "0-127", "30,60,90"}, "0-127");
 		registerArgument("midi-velocities", m_config.velocities, "Specify the velocities for note on events.", true, {"60", "0-127", "30,60,90"});
 		registerArgument("midi-programs", m_config.programChanges, "A list of program changes that are sent to the device", true, {"60", "0-127", "30,60,90"});
+		registerArgument("round-robins", m_config.roundRobins, "Number of times every note is recorded. The filename needs to contain {round} if more than one.", true, {"1", "4"});
 
 		registerArgument("pause-before", m_config.pauseBefore, "Pause time in seconds before the next note is being recorded. During this time, program changes are sent, if applicable", true, {"1.0"});
 		registerArgument("pause-after", m_config.pauseAfter, "Additional pause time in seconds after release has finished.", true, {"1.0"});
 		registerArgument("sustain-time", m_config.sustainLength, "Specify how many seconds a note is held down before released.", true, {"3.5"});
 		registerArgument("release-time", m_config.releaseLength, "Specify how many seconds recording is continued after a note has been released.", true, {"3.5"});
+		registerArgument("adaptive-release", m_config.adaptiveRelease, "Stop recording the release once the signal has decayed into the noise floor. release-time is used as the maximum release time.", true, {"1","0"});
+		registerArgument("release-hold", m_config.releaseHoldTime, "Time in seconds the signal needs to stay below the noise floor to stop recording if adaptive-release is enabled. At least one input block is examined.", true, {"0.1","0.5"});
+		registerArgument("adaptive-pauses", m_config.adaptivePauses, "Shorten the pauses between notes. pause-after ends once the signal stayed below the noise floor for release-hold seconds, pause-before is only as long as needed to switch programs. pause-before and pause-after are used as maximum.", true, {"1","0"});
+		registerArgument("retake-limit", m_config.retakeLimit, "A take is discarded and recorded again if input overflows occurred while recording it. Specify how many times this is done at most for the same voice, 0 disables it. If the limit is reached, the last take is kept.", true, {"0","2","5"});
+		registerArgument("retake-clipped", m_config.retakeClipped, "Record a take again if the input signal reached full scale, counts towards retake-limit.", true, {"1","0"});
 		registerArgument("release-velocity", m_config.releaseVelocity, "Release velocity that is sent to the device when a note is released.", true, {"3.5"});
 		registerArgument("midi-channel", m_config.midiChannel, "The MIDI channel that events are sent on. Range 0-15", true, {"0","15"});
+		registerArgument("channel-map", m_config.channelMap, "Record multiple parts of a multitimbral device at once. Each part is played on its own MIDI channel and recorded from its own input channels, specify a comma separated list of midichannel:firstinput-lastinput. Input channels start at 0, ai-channels needs to cover all of them. midi-channel is ignored if specified. The filename needs to contain {channel}.", true, {"0:0-1,1:2-3","0:0,1:1,9:2-3"});
 		registerArgument("noisefloor-duration", m_config.detectNoisefloorDuration, "Noise floor is detected after program start, used to trim  wave files to remove silence before/after the recording of a note. Specify the duration of noise floor detected here.", true, {"3.0","5"});
 
-		registerArgument("filename", m_config.filename, "Specify the filename that is used to create a recording. Some variables can be used to customize the file name and the path:\n "
+		registerArgument("filename", m_config.filename, "Specify the filename that is used to create a recording. Files are written as FLAC if the extension is .flac, as wave files otherwise, which switch to RF64 if they exceed 4 GiB. Some variables can be used to customize the file name and the path:\n "
 			"{note} Note number in range 0-127\n "
 			"{key} Note a human readable string like C#4. F#3, range is C-2 to G8\n "
 			"{velocity} Velocity in range 0-127\n "
-			"{program} Program change in range 0-127"
+			"{program} Program change in range 0-127\n "
+			"{channel} MIDI channel in range 0-15\n "
+			"{round} Round robin, starting at 0\n "
+			"{layer} Index of the velocity in midi-velocities, starting at 0. When slicing, index among the velocities that are played in the MIDI file\n "
+			"{cc:N} Value of controller N, only available when slicing, the value is taken from the MIDI file\n "
+			"{device} Index of the device if multiple devices are sampled, starting at 0. 0 if a single device is sampled\n "
+			"Numbers are zero padded, the number of digits can be specified, for example {note:2} or {cc:1:3}"
 			, true, {"~/autosampler/device/patch{program}/{note}_{key}_{velocity}.wav"});
 
 		registerArgument("skip-existing", m_config.skipExistingFiles, "Skip existing files that already exist on disk.", true, {"1","0"});
+		registerArgument("writer-threads", m_config.writerThreads, "Number of threads that trim and write recordings to disk while the next notes are recorded.", true, {"1","4"});
+		registerArgument("writer-queue", m_config.writerQueueSize, "Maximum number of recordings that wait to be written. Recording is paused if the writer threads cannot keep up.", true, {"4","16"});
+		registerArgument("stream-to-disk", m_config.streamToDisk, "Write recordings to disk while they are recorded instead of keeping them in memory. Recommended for long sustain/release times.", true, {"1","0"});
+		registerArgument("file-io", m_config.fileIO, "How recordings are written to disk. 'stdio' uses buffered I/O. On Linux, 'vectored' preallocates each file and writes it with a single system call, 'direct' additionally bypasses the page cache (O_DIRECT). 'uring' hands files over to io_uring and keeps many of them in flight, it falls back to 'vectored' if the kernel does not support it. All of them fall back to 'stdio' on other platforms. Does not apply to stream-to-disk.", true, {"stdio","vectored","direct","uring"});
+		registerArgument("journal", m_config.journalFile, "Session journal. Every completed take is recorded here. If a session is started again with the same journal, skip-existing uses it instead of checking every file on disk, takes that were interrupted are recorded again.", true, {"~/autosampler/device/journal.txt"});
+
+		registerArgument("metrics", m_config.metricsFile, "Timing statistics of the session are written to this JSON file when it has finished: execution time of the audio callback relative to the block length, input overflows per take, MIDI send times and writer queue depth. The filename needs to contain {device} if multiple devices are sampled, it is the only placeholder that is available.", true, {"~/autosampler/device/metrics.json"});
+		registerArgument("metrics-live", m_config.metricsLive, "Print the timing statistics after every take.", true, {"1","0"});
+		registerArgument("log-level", m_config.logLevel, "Messages below this level are not printed. Messages are written by a background thread, the recording never waits for them.", true, {"debug","info","warning","error"});
+
+		registerArgument("slice-audio", m_config.sliceAudioFile, "Instead of recording, cut an existing recording of a whole session into individual samples. Specify the wave file here and the MIDI file that has been played during the recording with slice-midi. release-time specifies how long a sample lasts after note off.", true, {"~/autosampler/session.wav"});
+		registerArgument("slice-midi", m_config.sliceMidiFile, "Standard MIDI file that has been played during the recording specified with slice-audio.", true, {"~/autosampler/session.mid"});
 
 		// further validation
 		if(m_config.filename.empty())
@@ -125,18 +279,69 @@ int Cli::run()
 				throw std::runtime_error("Program changes must be in range 0-127");
 		}
 
-		if (m_config.pauseBefore < 0.1f)
-			m_config.pauseBefore = 0.1f;
-		if (m_config.pauseAfter < 0.1f)
-			m_config.pauseAfter = 0.1f;
+		if (m_config.sliceAudioFile.empty() != m_config.sliceMidiFile.empty())
+			throw std::runtime_error("slice-audio and slice-midi need to be specified together");
+
+		const asLib::FilenameTemplate filenameTemplate(m_config.filename);
+
+		if (m_config.channelMap.size() > 1 && !filenameTemplate.hasPlaceholder(asLib::FilenameTemplate::PlaceholderChannel))
+			throw std::runtime_error("Filename needs to contain {channel} if multiple parts are recorded via channel-map");
+
+		if (m_config.roundRobins < 1)
+			throw std::runtime_error("round-robins must be at least 1");
+		if (m_config.roundRobins > 1 && !filenameTemplate.hasPlaceholder(asLib::FilenameTemplate::PlaceholderRound))
+			throw std::runtime_error("Filename needs to contain {round} if notes are recorded multiple times");
+
+		if (m_config.sliceAudioFile.empty() && filenameTemplate.hasPlaceholder(asLib::FilenameTemplate::PlaceholderController))
+			throw std::runtime_error("{cc:N} is only available when slicing, no controllers are sent while recording");
+
+		if (m_config.devices.size() > 1 && !filenameTemplate.hasPlaceholder(asLib::FilenameTemplate::PlaceholderDevice))
+			throw std::runtime_error("Filename needs to contain {device} if multiple devices are sampled");
+		if (m_config.devices.size() > 1 && !m_config.metricsFile.empty() && !asLib::FilenameTemplate(m_config.metricsFile).hasPlaceholder(asLib::FilenameTemplate::PlaceholderDevice))
+			throw std::runtime_error("Metrics filename needs to contain {device} if multiple devices are sampled");
+
+		if (asLib::FlacWriter::isFlacFilename(m_config.filename))
+		{
+			if (m_config.streamToDisk)
+				throw std::runtime_error("stream-to-disk is not supported for FLAC files");
+			if (m_config.sliceAudioFile.empty() && m_config.inputBits == 32)
+				throw std::runtime_error("FLAC files require integer samples, ai-bitrate needs to be 16 or 24");
+		}
+
+		if (m_config.writerThreads < 1)
+			throw std::runtime_error("At least one writer thread is required");
+		if (m_config.writerQueueSize < 1)
+			throw std::runtime_error("Writer queue size must be at least 1");
+
+		if (m_config.virtualAttack < 0.0f || m_config.virtualDecay < 0.0f)
+			throw std::runtime_error("Virtual instrument attack and decay times must not be negative");
+		if (m_config.virtualNoise < 0.0f || m_config.virtualNoise > 1.0f)
+			throw std::runtime_error("Virtual instrument noise level must be in range 0-1");
+
+		if (m_config.retakeLimit < 0)
+			throw std::runtime_error("retake-limit must not be negative");
+
+		if (m_config.releaseHoldTime < 0.0f)
+			throw std::runtime_error("Release hold time must not be negative");
+
+		// adaptive pauses compute their own lower limits
+		if (!m_config.adaptivePauses)
+		{
+			if (m_config.pauseBefore < 0.1f)
+				m_config.pauseBefore = 0.1f;
+			if (m_config.pauseAfter < 0.1f)
+				m_config.pauseAfter = 0.1f;
+		}
 	}
 	catch (const std::exception& e)
 	{
 		printUsage();
-		LOG("command line argument error: " << e.what());
+		LOG_ERROR("command line argument error: " << e.what());
 		return asLib::ErrMax;
 	}
 
+	asBase::setLogLevel(m_config.logLevel);
+
 	printUsage();
 	/*
 	m_config.inputHostApi = "Windows DirectSound";
@@ -162,9 +367,18 @@ int Cli::run()
 	*/
 	try
 	{
-		asLib::AutoSampler autosampler(m_config);
+		if(!m_config.sliceAudioFile.empty())
+		{
+			asLib::OfflineSlicer slicer(m_config);
 
-		autosampler.run();
+			slicer.run();
+
+			return 0;
+		}
+
+		asLib::Session session(m_config);
+
+		session.run();
 
 		return 0;
 	}
@@ -178,6 +392,9 @@ int Cli::run()
 
 void Cli::printUsage()
 {
+	// keep the order of messages that have been logged before
+	asBase::flushLog();
+
 	std::cout
 	<< 	"Autosampler can create multisamples of hardware MIDI devices." << std::endl
 	<< "It opens a MIDI port to send notes and an Audio input to record audio data." << std::endl
@@ -34,6 +34,10 @@ template<> bool  parse<bool>(const std::string& _input)
 }
 
 template<> std::vector<uint8_t>  parse< std::vector<uint8_t> >(const std::string& _input);
+template<> std::vector<asLib::ChannelMapping>  parse< std::vector<asLib::ChannelMapping> >(const std::string& _input);
+template<> std::vector<asLib::DevicePair>  parse< std::vector<asLib::DevicePair> >(const std::string& _input);
+template<> asLib::FileIO  parse<asLib::FileIO>(const std::string& _input);
+template<> asBase::LogLevel  parse<asBase::LogLevel>(const std::string& _input);
 
 class Cli
 {
@@ -69,6 +73,38 @@ private:
 		return ss.str();
 	}
 
+	static std::string toString(const std::vector<asLib::ChannelMapping>&)
+	{
+		return std::string();
+	}
+
+	static std::string toString(const std::vector<asLib::DevicePair>&)
+	{
+		return std::string();
+	}
+
+	static std::string toString(const asLib::FileIO& _value)
+	{
+		switch(_value)
+		{
+		case asLib::FileIOVectored:	return "vectored";
+		case asLib::FileIODirect:	return "direct";
+		case asLib::FileIOUring:	return "uring";
+		default:					return "stdio";
+		}
+	}
+
+	static std::string toString(const asBase::LogLevel& _value)
+	{
+		switch(_value)
+		{
+		case asBase::LogDebug:		return "debug";
+		case asBase::LogWarning:	return "warning";
+		case asBase::LogError:		return "error";
+		default:					return "info";
+		}
+	}
+
 	static std::string toString(const bool& _value)
 	{
 		return _value ? "1" : "0";
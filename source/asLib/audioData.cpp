@@ -1,12 +1,9 @@
 #include "audioData.h"
-#include "error.h"
 
+#include <algorithm>
 #include <cmath>
-#include <limits>
 #include <memory.h>
 
-#include "../portaudio/include/portaudio.h"
-
 void asLib::AudioData::append(const void* _data, size_t _lengthInFrames)
 {
 	const auto oldSize = m_buffer.size();
@@ -18,9 +15,30 @@ void asLib::AudioData::append(const void* _data, size_t _lengthInFrames)
 	::memcpy(&m_buffer[oldSize], _data, appendSize);
 }
 
+void asLib::AudioData::append(const void* _data, size_t _lengthInFrames, size_t _sourceChannelCount, size_t _firstChannel)
+{
+	if(_sourceChannelCount == m_channelCount)
+	{
+		append(_data, _lengthInFrames);
+		return;
+	}
+
+	const auto oldSize = m_buffer.size();
+	const auto frameSize = bytesPerFrame();
+	const auto sourceFrameSize = m_bytesPerSample * _sourceChannelCount;
+
+	m_buffer.resize(oldSize + frameSize * _lengthInFrames);
+
+	const auto* src = static_cast<const uint8_t*>(_data) + _firstChannel * m_bytesPerSample;
+	auto* dst = &m_buffer[oldSize];
+
+	for(size_t i=0; i<_lengthInFrames; ++i, src += sourceFrameSize, dst += frameSize)
+		::memcpy(dst, src, frameSize);
+}
+
 bool asLib::AudioData::removeAt(size_t _frame, size_t _count)
 {
-	const auto byteOffset = _frame * bytesPerFrame();
+	const auto byteOffset = (m_startFrame + _frame) * bytesPerFrame();
 	const auto byteRemoveSize = _count * bytesPerFrame();
 
 	auto last = byteOffset + byteRemoveSize;
@@ -38,150 +56,89 @@ bool asLib::AudioData::removeAt(size_t _frame, size_t _count)
 
 float asLib::AudioData::floatValue(size_t _frame, size_t _channel) const
 {
-	if(_channel >= m_channelCount)
+	if(_channel >= m_channelCount || _frame >= lengthInFrames())
 		return 0.0f;
 
-	const auto byteOffset = bytesPerFrame() * _frame;
-
-	if((byteOffset + bytesPerFrame()) >= m_buffer.size())
-		return 0.0f;
+	return SampleConverter::toFloat(m_sampleFormat, data() + bytesPerFrame() * _frame + bytesPerSample() * _channel);
+}
 
-	const auto* first = &m_buffer[byteOffset];
+void asLib::AudioData::toFloat(float* _dst, const size_t _firstFrame, const size_t _frameCount) const
+{
+	SampleConverter::toFloat(m_sampleFormat, _dst, data() + _firstFrame * bytesPerFrame(), _frameCount * m_channelCount);
+}
 
-	switch (m_format)
-	{
-	case paFloat32:
-		{
-			return *reinterpret_cast<const float*>(first);		
-		}
-	case paInt32:
-		{
-			const auto intValue = *reinterpret_cast<const int32_t*>(first);
-			return static_cast<float>(static_cast<double>(intValue) / -static_cast<double>(std::numeric_limits<int32_t>::min()));			
-		}
-	case paInt24:
-		{
-			union ConvertHelper
-			{
-				int8_t buf[4];
-				int32_t asInt;
-			};
-
-			ConvertHelper helper;
-
-			helper.asInt = 0;
-			helper.buf[0] = first[0];
-			helper.buf[1] = first[1];
-			helper.buf[2] = first[2];
-
-			// fix sign
-			helper.asInt <<= 8;
-			helper.asInt >>= 8;
-
-			return static_cast<float>(static_cast<double>(helper.asInt) / static_cast<double>(1 << 23));	
-		}
-	case paInt16:
-		{
-			const auto int16Value = *reinterpret_cast<const int16_t*>(first);
-			return static_cast<float>(static_cast<double>(int16Value) / -static_cast<double>(std::numeric_limits<int16_t>::min()));			
-		}
-	case paInt8:
-	case paUInt8:
-		return static_cast<float>(static_cast<double>(*first) / -static_cast<double>(std::numeric_limits<int8_t>::min()));
-	default:
-		throw Error(ErrAudioInput, "Unknown stream format");
-	}	
+float asLib::AudioData::peak() const
+{
+	if(empty())
+		return 0.0f;
+	return SampleConverter::peak(m_sampleFormat, data(), lengthInFrames() * m_channelCount);
 }
 
-void asLib::AudioData::trimStart(float _maxValue)
+float asLib::AudioData::rms() const
 {
 	if(empty())
-		return;
-	
-	auto found = false;
+		return 0.0f;
+	const auto sampleCount = lengthInFrames() * m_channelCount;
+	return static_cast<float>(std::sqrt(SampleConverter::sumOfSquares(m_sampleFormat, data(), sampleCount) / static_cast<double>(sampleCount)));
+}
 
-	size_t index = 0;
+bool asLib::AudioData::findFirstFrameAbove(const float _maxValue, size_t& _frame) const
+{
+	size_t index;
 
-	for(size_t f=0; f<lengthInFrames() && !found; ++f)
-	{
-		for(size_t c=0; c<getChannelCount() && !found; ++c)
-		{
-			const float g = std::abs(floatValue(f, c));
+	if(empty() || !SampleConverter::findFirstAbove(m_sampleFormat, data(), lengthInFrames() * m_channelCount, _maxValue, index))
+		return false;
 
-			if(g >= _maxValue)
-			{
-				if(f == 0)
-					return;
+	_frame = index / m_channelCount;
+	return true;
+}
 
-				found = true;
-				index = f-1;
+bool asLib::AudioData::findLastFrameAbove(const float _maxValue, size_t& _frame) const
+{
+	size_t index;
 
-				break;				
-			}
-		}
-	}
+	if(empty() || !SampleConverter::findLastAbove(m_sampleFormat, data(), lengthInFrames() * m_channelCount, _maxValue, index))
+		return false;
 
-	if(!found)
-	{
-		clear();
-		return;
-	}
-	
-	const auto bytesToRemove = index * bytesPerFrame();
-	if(bytesToRemove == m_buffer.size())
-		clear();
-	else
-		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + bytesToRemove);
+	_frame = index / m_channelCount;
+	return true;
 }
 
-void asLib::AudioData::trimEnd(float _maxValue)
+void asLib::AudioData::trimStart(float _maxValue)
 {
 	if(empty())
 		return;
 
-	auto found = false;
-
-	size_t index = 0;
+	size_t frame;
 
-	for(size_t f=m_buffer.size()-1; f<std::numeric_limits<size_t>::max() && !found; --f)
+	if(!findFirstFrameAbove(_maxValue, frame))
 	{
-		for(size_t c=0; c<getChannelCount() && !found; ++c)
-		{
-			const float g = std::abs(floatValue(f, c));
+		clear();
+		return;
+	}
 
-			if(g >= _maxValue)
-			{
-				if(f == m_buffer.size()-1)
-					return;
+	// keep one frame of silence in front of the signal
+	if(frame > 1)
+		m_startFrame += frame - 1;
+}
 
-				found = true;
-				index = f-1;
+void asLib::AudioData::trimEnd(float _maxValue)
+{
+	if(empty())
+		return;
 
-				break;				
-			}
-		}
-	}
+	size_t frame;
 
-	if(!found)
+	if(!findLastFrameAbove(_maxValue, frame))
 	{
 		clear();
 		return;
 	}
 
-	const auto newSize = bytesPerFrame() * index;
-	m_buffer.resize(newSize);
-}
+	// keep one frame of silence after the signal
+	const auto length = std::min(frame + 2, lengthInFrames());
 
-size_t asLib::AudioData::bytesPerSample() const
-{
-	return Pa_GetSampleSize(m_format);
-}
-
-asLib::AudioData* asLib::AudioData::clone()
-{
-	auto* clone = new AudioData(m_format, m_channelCount);
-	clone->m_buffer.assign(m_buffer.begin(), m_buffer.end());
-	return clone;
+	m_buffer.resize((m_startFrame + length) * bytesPerFrame());
 }
 
 int asLib::AudioData::getBitsPerSample() const
@@ -191,5 +148,5 @@ int asLib::AudioData::getBitsPerSample() const
 
 bool asLib::AudioData::getIsFloat() const
 {
-	return m_format == paFloat32;
+	return m_sampleFormat == SampleFormatFloat32;
 }
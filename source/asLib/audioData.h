@@ -4,42 +4,60 @@
 #include <cstddef>
 #include <vector>
 
+#include "sampleConverter.h"
+
 namespace asLib
 {
 	class AudioData
 	{
 	public:
-		AudioData(unsigned long _sampleFormat, size_t _channelCount) : m_format(_sampleFormat), m_channelCount(_channelCount)
+		AudioData(unsigned long _sampleFormat, size_t _channelCount) : m_format(_sampleFormat), m_sampleFormat(toSampleFormat(_sampleFormat)), m_bytesPerSample(getSampleSize(m_sampleFormat)), m_channelCount(_channelCount)
 		{
 		}
 		AudioData(const AudioData&) = delete;
 
 		void append(const void* _data, size_t _lengthInFrames);
+		// appends the channels _firstChannel to _firstChannel + getChannelCount() - 1 of interleaved data that has _sourceChannelCount channels
+		void append(const void* _data, size_t _lengthInFrames, size_t _sourceChannelCount, size_t _firstChannel);
 		bool removeAt(size_t _frame, size_t _count);
 		float floatValue(size_t _frame, size_t _channel) const;
 
+		// block-wise access, prefer these over floatValue() when processing larger amounts of data
+		void toFloat(float* _dst, size_t _firstFrame, size_t _frameCount) const;
+		float peak() const;
+		float rms() const;
+
+		// trimming does not move any data, trimStart() only moves the start of the visible range
 		void trimStart(float _maxValue);
 		void trimEnd(float _maxValue);
 
-		bool empty() const					{ return m_buffer.empty(); }
-		void clear()						{ m_buffer.clear(); }
+		// search for the first/last frame that has at least one sample with an absolute value >= _maxValue. Returns false if there is none
+		bool findFirstFrameAbove(float _maxValue, size_t& _frame) const;
+		bool findLastFrameAbove(float _maxValue, size_t& _frame) const;
+
+		bool empty() const					{ return lengthInFrames() == 0; }
+		void clear()						{ m_buffer.clear(); m_startFrame = 0; }
 		void reserve(size_t _frameCount)	{ m_buffer.reserve(bytesPerFrame() * _frameCount); }
 
-		size_t bytesPerSample() const;
+		size_t bytesPerSample() const		{ return m_bytesPerSample; }
 		size_t bytesPerFrame() const		{ return bytesPerSample() * m_channelCount; }
-		size_t lengthInFrames() const		{ return m_buffer.size() / bytesPerFrame(); }
+		size_t lengthInFrames() const		{ return m_buffer.size() / bytesPerFrame() - m_startFrame; }
 		size_t getChannelCount() const		{ return m_channelCount; }
-
-		AudioData* clone();
+		unsigned long getFormat() const		{ return m_format; }
+		SampleFormat getSampleFormat() const	{ return m_sampleFormat; }
 
 		AudioData& operator = (const AudioData&) = delete;
 		int getBitsPerSample() const;
-		const std::vector<uint8_t>& data() const	{ return m_buffer; }
+		const uint8_t* data() const			{ return m_buffer.data() + m_startFrame * bytesPerFrame(); }
+		size_t dataSize() const				{ return lengthInFrames() * bytesPerFrame(); }
 		bool getIsFloat() const;
 
 	private:
 		std::vector<uint8_t> m_buffer;
+		size_t m_startFrame = 0;
 		const unsigned long m_format;
+		const SampleFormat m_sampleFormat;
+		const size_t m_bytesPerSample;
 		const size_t m_channelCount;
 	};
 }
@@ -0,0 +1,47 @@
+#include "audioDataPool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace asLib
+{
+AudioDataPool::AudioDataPool(const unsigned long _sampleFormat, const size_t _channelCount, const size_t _reservedFrames, const size_t _bufferCount)
+{
+	const auto bufferCount = std::max(static_cast<size_t>(1), _bufferCount);
+
+	m_buffers.reserve(bufferCount);
+	m_freeBuffers.reserve(bufferCount);
+
+	for(size_t i=0; i<bufferCount; ++i)
+	{
+		m_buffers.emplace_back(new AudioData(_sampleFormat, _channelCount));
+		m_buffers.back()->reserve(_reservedFrames);
+		m_freeBuffers.push_back(m_buffers.back().get());
+	}
+}
+
+AudioData* AudioDataPool::acquire()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_cvBufferAvailable.wait(lock, [this] { return !m_freeBuffers.empty(); });
+
+	auto* data = m_freeBuffers.back();
+	m_freeBuffers.pop_back();
+	return data;
+}
+
+void AudioDataPool::release(AudioData* _data)
+{
+	assert(std::find_if(m_buffers.begin(), m_buffers.end(), [_data](const std::unique_ptr<AudioData>& _d) { return _d.get() == _data; }) != m_buffers.end());
+
+	_data->clear();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_freeBuffers.push_back(_data);
+	}
+
+	m_cvBufferAvailable.notify_one();
+}
+}
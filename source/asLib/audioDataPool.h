@@ -0,0 +1,37 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "audioData.h"
+
+namespace asLib
+{
+	// Preallocated set of AudioData buffers that are handed from the capture thread to the writers and back,
+	// recorded takes are never copied and no memory is allocated between notes
+	class AudioDataPool
+	{
+	public:
+		AudioDataPool(unsigned long _sampleFormat, size_t _channelCount, size_t _reservedFrames, size_t _bufferCount);
+		AudioDataPool(const AudioDataPool&) = delete;
+
+		// blocks until a buffer is available
+		AudioData* acquire();
+
+		// returns a buffer to the pool, it is cleared but keeps its memory
+		void release(AudioData* _data);
+
+		size_t getBufferCount() const		{ return m_buffers.size(); }
+
+		AudioDataPool& operator = (const AudioDataPool&) = delete;
+
+	private:
+		std::vector<std::unique_ptr<AudioData>> m_buffers;
+		std::vector<AudioData*> m_freeBuffers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cvBufferAvailable;
+	};
+}
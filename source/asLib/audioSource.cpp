@@ -0,0 +1,20 @@
+#include "audioSource.h"
+#include "error.h"
+
+#include "../portaudio/include/portaudio.h"
+
+namespace asLib
+{
+unsigned long bitCountToSampleFormat(const int _bitCount)
+{
+	switch (_bitCount)
+	{
+	case 8:		return paInt8;
+	case 16:	return paInt16;
+	case 24:	return paInt24;
+	case 32:	return paFloat32;
+	default:
+		throw Error(ErrInvalidInputBitCount, "Invalid bit count for input specified (should be 8, 16, 24 or 32");
+	}
+}
+}
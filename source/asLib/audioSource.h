@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace asLib
+{
+	class CallbackMetrics;
+
+	// Provides the audio that is being recorded
+	class AudioSource
+	{
+	public:
+		// Receives captured audio, return false to stop. _time is the capture time of the first frame in seconds, measured
+		// with the clock of getTime(), or 0 if unknown. _overflow is true if the device dropped input before this block.
+		// Might be called from a real-time thread
+		typedef std::function<bool(const void* _data, size_t _frameCount, double _time, bool _overflow)> Callback;
+
+		virtual ~AudioSource() = default;
+
+		virtual void start(Callback _callback) = 0;
+		virtual void stop() = 0;
+
+		// Sources that are not driven by a device produce the next block synchronously on the calling thread.
+		// Returns false if the source delivers audio on its own or if it has been stopped
+		virtual bool pull()							{ return false; }
+
+		virtual double getTime() const = 0;
+		virtual float getSamplerate() const = 0;
+		virtual unsigned long getSampleFormat() const = 0;		// PortAudio sample format
+		virtual size_t getChannelCount() const = 0;
+
+		// timing of the real-time callback, null for sources that do not have one
+		virtual const CallbackMetrics* getCallbackMetrics() const	{ return nullptr; }
+
+		// fraction of the available time that the driver spends in the callback, 0 if unknown
+		virtual double getCpuLoad() const							{ return 0.0; }
+	};
+
+	// maps the bit depth given in the config to a PortAudio sample format, throws if it is not supported
+	unsigned long bitCountToSampleFormat(int _bitCount);
+}
@@ -5,6 +5,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iomanip>
 
 
@@ -15,590 +17,1102 @@
 #include <utility>
 #include <vector>
 
-#ifdef _WIN32
-#include <direct.h>
-#else
-#include <sys/stat.h>
-#define _mkdir(PATH) mkdir(PATH, 644)
-#endif
-
-#include <iostream>
 
+#include "directoryCache.h"
+#include "fileIndex.h"
+#include "fileWriter.h"
+#include "flacWriter.h"
+#include "portAudioSource.h"
+#include "portMidiSink.h"
+#include "virtualInstrument.h"
 #include "wavWriter.h"
 #include "../asBase/logging.h"
-
-#include "../portaudio/include/portaudio.h"
-
-#include "../portmidi/pm_common/portmidi.h"
+#include "../asBase/threadPool.h"
 
 namespace asLib
 {
 constexpr float g_noiseFloorFactor = 1.25f;
 constexpr uint8_t g_programChangeNone = 0xff;
-	
-static int portAudioCallback(const void* _inputBuffer, void*, const unsigned long _framesPerBuffer, const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void* _userData)
+constexpr float g_inputBufferSeconds = 2.0f;		// amount of audio that can be buffered if the capture thread stalls
+constexpr size_t g_inputBufferMinBlocks = 16;
+constexpr size_t g_inputOverflowQueueSize = 256;
+constexpr size_t g_timeAnchorQueueSize = 64;
+constexpr size_t g_minPauseBlocks = 4;				// adaptive pauses: lower limit of the time that a note on is scheduled ahead
+constexpr double g_clockMeasureSeconds = 10.0;		// minimum time span to measure the samplerate of the device
+constexpr double g_maxClockDeviation = 0.01;		// measurements that deviate more than this from the nominal samplerate are ignored
+constexpr size_t g_voiceChunkSize = 4096;			// voices whose filenames are expanded by one job when the voice list is generated
+
+namespace
 {
-	auto* sampler = static_cast<AutoSampler*>(_userData);
-	if(sampler->audioInputCallback(_inputBuffer, _framesPerBuffer))
-		return paContinue;
-	return paComplete;
+	// a take clipped if a sample reached the largest positive value of the format. Float input is not clipped by the
+	// driver, everything at or above full scale counts
+	float getClipLevel(const SampleFormat _format)
+	{
+		switch(_format)
+		{
+		case SampleFormatInt8:
+		case SampleFormatUInt8:		return 127.0f / 128.0f;
+		case SampleFormatInt16:		return 32767.0f / 32768.0f;
+		case SampleFormatInt24:		return 8388607.0f / 8388608.0f;
+		case SampleFormatInt32:		return static_cast<float>(2147483647.0 / 2147483648.0);
+		default:					return 1.0f;
+		}
+	}
 }
-
-static int bitCountToSampleFormat(int bitCount)
+	
+AutoSampler::AutoSampler(Config _config, std::shared_ptr<asBase::ThreadPool> _writerPool, std::shared_ptr<SessionJournal> _journal/* = nullptr*/)
+	: m_config(std::move(_config))
+	, m_filenameTemplate(m_config.filename)
+	, m_journal(std::move(_journal))
+	, m_writerPool(std::move(_writerPool))
 {
-	switch (bitCount)
+	if(!m_journal && !m_config.journalFile.empty())
+		m_journal.reset(new SessionJournal(m_config.journalFile));
+
+	if(m_config.virtualInstrument)
 	{
-	case 8:		return paInt8;
-	case 16:	return paInt16;
-	case 24:	return paInt24;
-	case 32:	return paFloat32;
-	default:
-		throw Error(ErrInvalidInputBitCount, "Invalid bit count for input specified (should be 8, 16, 24 or 32");
+		std::shared_ptr<VirtualInstrument> instrument(new VirtualInstrument(m_config));
+		m_audioSource = instrument;
+		m_midiSink = instrument;
+	}
+	else
+	{
+		m_audioSource.reset(new PortAudioSource(m_config));
+		m_midiSink.reset(new PortMidiSink(m_config, *m_audioSource));
 	}
-}
 
-bool strequal(const std::string& _a, const std::string& _b)
-{
-    return _a.size() == _b.size() && std::equal(_a.cbegin(), _a.cend(), _b.cbegin(),[](const std::string::value_type& _a, const std::string::value_type& _b)
-    {
-		return toupper(_a) == toupper(_b);
-    });
+	m_samplerate = m_audioSource->getSamplerate();
+	m_sampleFormat = m_audioSource->getSampleFormat();
+
+	m_detectNoiseFloorDuration = static_cast<int>(m_config.detectNoisefloorDuration * m_samplerate);
+	m_pauseBefore = static_cast<int>(m_config.pauseBefore * m_samplerate);
+	m_sustainLength = static_cast<int>(m_config.sustainLength * m_samplerate);
+	m_releaseLength = static_cast<int>(m_config.releaseLength * m_samplerate);
+	// at least one block, otherwise an adaptive release/pause could end before any of its audio has been examined
+	m_releaseHoldTime = std::max(static_cast<size_t>(m_config.releaseHoldTime * m_samplerate), static_cast<size_t>(m_config.inputBlockSize));
+	m_pauseAfter = static_cast<int>(m_config.pauseAfter * m_samplerate);
+	m_minPause = std::min(m_pauseBefore, static_cast<size_t>(m_config.inputBlockSize) * g_minPauseBlocks);
+
+	m_channelCount = m_audioSource->getChannelCount();
+
+	m_metrics.reset(new SessionMetrics(m_audioSource->getCallbackMetrics(), m_writerPool->getMaxQueueSize()));
+
+	createParts();
+	generateVoices();
+	createDirectories();
+
+	const auto inputBufferFrames = std::max(static_cast<size_t>(m_config.inputBlockSize) * g_inputBufferMinBlocks, static_cast<size_t>(g_inputBufferSeconds * m_samplerate));
+	m_inputBuffer.reset(new RingBuffer(getSampleSize(toSampleFormat(m_sampleFormat)) * m_channelCount, inputBufferFrames));
+
+	m_inputOverflows.reset(new RingBuffer(sizeof(InputOverflow), g_inputOverflowQueueSize));
+	m_timeAnchors.reset(new RingBuffer(sizeof(TimeAnchor), g_timeAnchorQueueSize));
+
+	setState(DetectNoiseFloor);
+
+	m_audioSource->start([this](const void* _data, size_t _frameCount, double _time, bool _overflow)
+	{
+		return audioInputCallback(_data, _frameCount, _time, _overflow);
+	});
+
+	m_captureThread = std::thread(&AutoSampler::captureThreadFunc, this);
 }
 
-void strreplace(std::string& _string, const std::string& _search, const std::string& _replacement)
+AutoSampler::~AutoSampler()
 {
-	for(size_t searchPos = 0; searchPos < _string.size(); )
-	{
-		auto pos = _string.find(_search, searchPos);
+	m_captureFinished = true;
 
-		if(pos == std::string::npos)
-			break;
+	m_audioSource->stop();
 
-		_string.replace(pos, _search.size(), _replacement);
+	if(m_captureThread.joinable())
+		m_captureThread.join();
 
-		searchPos = pos + _replacement.size();
+	// do not leave partial recordings behind
+	for(auto& part : m_parts)
+	{
+		if(part.streamWriter)
+			part.streamWriter->discard();
 	}
+
+	// the MIDI sink may use the audio source as its clock
+	m_midiSink.reset();
+	m_audioSource.reset();
 }
 
-void createDirectoryRecursive(const std::string& filename)
+void AutoSampler::run()
 {
-	for(size_t searchPos=0; searchPos < filename.size();)
-	{
-		size_t pos = filename.find_first_of("/\\", searchPos);
+	if(m_captureThread.joinable())
+		m_captureThread.join();
 
-		if(pos == std::string::npos)
-			break;
+	if(m_config.metricsLive)
+		m_metrics->log();
 
-		const auto path = filename.substr(0,pos);
+	if(!m_config.metricsFile.empty())
+		m_metrics->writeJson(createFilename(FilenameTemplate(m_config.metricsFile), Voice(), m_config.deviceIndex), static_cast<double>(m_captureFramePosition - m_sessionStartFramePosition) / m_samplerate, m_samplerate, m_config.inputBlockSize);
 
-		searchPos = pos + 1;
+	if(m_measuredSamplerate > 0.0)
+		LOG("Sample clock of the audio input deviates by " << getClockDriftPpm() << " ppm from the session clock");
 
-		if(path.back() == ':')
-			continue;	// skip windows drive letter
+	if(m_inputOverflowCount > 0)
+		LOG_WARNING(m_inputOverflowCount << " input overflows occurred during this session");
 
-		_mkdir(path.c_str());		
-	}
+	if(m_captureError)
+		std::rethrow_exception(m_captureError);
 }
 
-std::string noteToString(uint8_t _note)
+void AutoSampler::sendMidi(uint8_t a, uint8_t b, uint8_t c, const double _time/* = 0.0*/) const
 {
-	const char* keys[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+	a &= 0xf0;
+
+	// all parts play the same voice
+	for(const auto& part : m_parts)
+	{
+		const auto ahead = _time > 0.0 ? _time - m_audioSource->getTime() : 0.0;
+		const auto start = std::chrono::steady_clock::now();
 
-	const auto octave = _note / 12;
-	const auto n = _note - octave * 12;
+		m_midiSink->send(a | (part.midiChannel & 0x0f), b, c, _time);
 
-	std::stringstream ss; ss << keys[n] << (octave - 2);	// C-2 to G8
-	return ss.str();
+		m_metrics->addMidiEvent(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), _time > 0.0, ahead);
+	}
 }
-	
-static bool s_apisInitialized;
 
-static void initApis()
+void AutoSampler::scheduleMidi(const uint8_t a, const uint8_t b, const uint8_t c, const uint64_t _framePosition) const
 {
-	if(s_apisInitialized)
-		return;
-	
-	Pa_Initialize();
-	Pm_Initialize();
+	// stream position => capture time of the audio source (via the capture time of the last block), the MIDI sink maps it to its own clock
+	const auto frameDelta = static_cast<double>(_framePosition) - static_cast<double>(m_timeAnchor.framePosition);
+
+	const auto samplerate = m_measuredSamplerate > 0.0 ? m_measuredSamplerate : static_cast<double>(m_samplerate);
 
-	s_apisInitialized = true;	
+	sendMidi(a, b, c, m_timeAnchor.adcTime + frameDelta / samplerate);
 }
 
-AutoSampler::AutoSampler(Config _config) : m_config(std::move(_config))
+void AutoSampler::sendNoteOn(const uint64_t _framePosition)
 {
-	initApis();
+	const auto& voice = m_voices[m_currentVoice];
+	const auto note = voice.note;
+	const auto velocity = voice.velocity;
 
-	generateVoices();
+	LOG("Sending Note ON for note " << FilenameTemplate::getKeyName(note) << " (" << static_cast<int>(note) << "), velocity " << static_cast<int>(velocity) << ", frame " << _framePosition);
 
-	initMidiOutput();
+	if(canScheduleMidi())
+		scheduleMidi(M_NOTEON, note, velocity, _framePosition);
+	else
+		sendMidi(M_NOTEON, note, velocity);
 
-	initAudioInput();
+	m_noteOnSent = true;
+}
 
-	m_detectNoiseFloorDuration = static_cast<int>(m_config.detectNoisefloorDuration * m_samplerate);
-	m_pauseBefore = static_cast<int>(m_config.pauseBefore * m_samplerate);
-	m_sustainLength = static_cast<int>(m_config.sustainLength * m_samplerate);
-	m_releaseLength = static_cast<int>(m_config.releaseLength * m_samplerate);
-	m_pauseAfter = static_cast<int>(m_config.pauseAfter * m_samplerate);
+void AutoSampler::sendNoteOff(const uint64_t _framePosition)
+{
+	const auto note = m_voices[m_currentVoice].note;
 
-	m_audioData->reserve((m_sustainLength + m_releaseLength) << 1);	 // a bit extra, block size causes lengths to be exceeded
+	LOG("Sending Note off for note " << FilenameTemplate::getKeyName(note) << " (" << static_cast<int>(note) << "), release velocity " << static_cast<int>(m_config.releaseVelocity) << ", frame " << _framePosition);
 
-	setState(DetectNoiseFloor);
+	if(canScheduleMidi())
+		scheduleMidi(M_NOTEOFF, note, m_config.releaseVelocity, _framePosition);
+	else
+		sendMidi(M_NOTEOFF, note, m_config.releaseVelocity);
 
-	Pa_StartStream(m_inputStream);
+	m_noteOffSent = true;
 }
 
-AutoSampler::~AutoSampler()
+void AutoSampler::setState(State _state)
 {
-	if(m_inputStream)
-	{
-		Pa_CloseStream(m_inputStream);
-		m_inputStream = nullptr;		
-	}
+	if(_state == m_state)
+		return;
+
+	m_state = _state;
+	m_stateDurationInFrames = 0;
 
-	if(m_outputStream)
+	switch (_state)
 	{
-		Pm_Close(m_outputStream);
-		m_outputStream = nullptr;
-	}
+	case DetectNoiseFloor:
+		LOG("Detecting noise floor...");
+		for(auto& part : m_parts)
+			part.audioData->clear();
+		break;
+	case PauseBefore:
+		{
+			for(auto& part : m_parts)
+				part.audioData->clear();
 
-	Pm_Terminate();
-	Pa_Terminate();
+			m_noteOnSent = false;
+			m_noteOffSent = false;
 
-	s_apisInitialized = false;
-}
+			// usually sent during the previous pause already
+			sendProgramChange(m_voices[m_currentVoice].program);
 
-void AutoSampler::run()
-{
-	while(true)
-	{
+			// schedule the note on ahead of time so that it is played exactly at the first frame of the recording
+			if(canScheduleMidi())
+				sendNoteOn(m_captureFramePosition + getPauseBeforeLength());
+		}
+		break;
+	case Sustain:
 		{
-			std::lock_guard<std::mutex> lockPendingWrites(m_lockPendingWrites);
-			for(auto it = m_pendingWrites.begin(); it != m_pendingWrites.end();)
+			m_takeInputOverflowCount = 0;
+			m_takeDeviceOverflowCount = 0;
+
+			for(auto& part : m_parts)
+			{
+				part.audioData->clear();
+				part.takeClipped = false;
+
+				createFilename(part.filename, m_voices[m_currentVoice], part);
+
+				if(m_config.streamToDisk)
+					beginStreamTake(part);
+			}
+
+			if(!m_noteOnSent)
+				sendNoteOn(m_captureFramePosition);
+
+			if(canScheduleMidi())
+				sendNoteOff(m_captureFramePosition + m_sustainLength);
+		}
+		break;
+	case Release:
+		m_tailEnd = 0;
+		m_releaseDecayed = false;
+		if(!m_noteOffSent)
+			sendNoteOff(m_captureFramePosition);
+		break;
+	case PauseAfter:
+		{
+			const auto deviceOverflows = m_takeDeviceOverflowCount;
+			const auto clipped = isTakeClipped();
+
+			const auto& voice = m_voices[m_currentVoice];
+			const auto& filename = m_parts.front().filename;
+			const auto failed = m_takeInputOverflowCount > 0 || deviceOverflows > 0 || (clipped && m_config.retakeClipped);
+			const auto retake = failed && voice.retake < m_config.retakeLimit;
+
+			if(m_takeInputOverflowCount > 0)
+				LOG_WARNING(m_takeInputOverflowCount << " input overflows occurred while recording " << filename);
+			if(deviceOverflows > 0)
+				LOG_WARNING("The audio device reported " << deviceOverflows << " input overflows while recording " << filename);
+			if(clipped)
+				LOG_WARNING("The input signal clipped while recording " << filename);
+
+			SessionMetrics::Take take;
+			take.note = voice.note;
+			take.velocity = voice.velocity;
+			take.program = voice.program == g_programChangeNone ? -1 : voice.program;
+			take.bufferOverflows = m_takeInputOverflowCount;
+			take.deviceOverflows = deviceOverflows;
+			take.clipped = clipped;
+			take.retake = retake;
+
+			if(retake)
 			{
-				const auto& pendingWrite = it->second;
+				// record it again right away, the device still plays the same program
+				auto again = voice;
+				++again.retake;
 
-				if(pendingWrite.data == nullptr)
+				LOG_WARNING("Recording " << filename << " again, attempt " << (again.retake + 1) << " of " << (m_config.retakeLimit + 1));
+
+				m_voices.insert(m_voices.begin() + static_cast<std::ptrdiff_t>(m_currentVoice) + 1, again);
+				++m_retakeCount;
+			}
+			else if(failed && m_config.retakeLimit > 0)
+			{
+				LOG_WARNING("Keeping " << filename << ", it has been recorded " << (m_config.retakeLimit + 1) << " times");
+			}
+
+			m_tailEnd = 0;
+
+			// prepare the next voice while this one is being written, gives the device the whole pause to switch programs
+			if(m_currentVoice + 1 < m_voices.size())
+				sendProgramChange(m_voices[m_currentVoice + 1].program);
+
+			for(auto& part : m_parts)
+			{
+				if(retake)
+				{
+					if(part.streamWriter)
+					{
+						part.streamWriter->discard();
+						part.streamWriter.reset();
+					}
+					continue;
+				}
+
+				if(m_config.streamToDisk)
 				{
-					pendingWrite.thread->join();
-					m_pendingWrites.erase(it++);
+					finishStreamTake(part);
+					continue;
 				}
-				else
-					++it;
+
+				// hand the recorded buffer over to the writers and continue with a fresh one
+				auto* data = part.audioData;
+				auto pool = part.audioDataPool;
+				const auto filename = part.filename;	// owned by the job
+				const auto noiseFloor = part.noiseFloor;
+				const auto samplerate = m_samplerate;
+				const auto io = m_config.fileIO;
+				auto* writerPool = m_writerPool.get();
+				auto journal = m_journal;
+				auto partVoice = m_voices[m_currentVoice];
+				partVoice.channel = part.midiChannel;
+
+				// blocks if the writers can not keep up
+				m_writerPool->push([data, pool, filename, noiseFloor, samplerate, io, writerPool, journal, partVoice]
+				{
+					auto pending = false;
+					try
+					{
+						// asynchronous writes return the buffer once the file has been closed
+						pending = writeWaveFile(filename, data, noiseFloor, samplerate, io, writerPool, [data, pool] { pool->release(data); }, journal, partVoice);
+					}
+					catch(...)
+					{
+						pool->release(data);
+						throw;
+					}
+					if(!pending)
+						pool->release(data);
+				});
+
+				part.audioData = pool->acquire();
 			}
 
-			if(m_state == Finished && m_pendingWrites.empty())
-				break;
+			m_metrics->addTake(take, filename, m_writerPool->getQueueSize(), m_audioSource->getCpuLoad());
+
+			if(m_config.metricsLive)
+				m_metrics->log();
+		}
+		break;
+	case Finished: 
+		if(!m_voices.empty())
+		{
+			const auto seconds = static_cast<float>(m_captureFramePosition - m_sessionStartFramePosition) / m_samplerate;
+			const auto voiceCount = m_voices.size() - m_retakeCount;
+			LOG("Recorded " << voiceCount << " voices in " << seconds << " seconds, " << (seconds / static_cast<float>(voiceCount)) << " seconds per voice");
+
+			if(m_retakeCount)
+				LOG_WARNING(m_retakeCount << " takes have been recorded again because of input overflows or clipping");
 		}
-		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+		break;
+	default:;
 	}
 }
 
-void AutoSampler::initAudioInput()
+bool AutoSampler::writeWaveFile(const std::string& _filename, AudioData* _data, const float _noiseFloor, const float _samplerate, const FileIO _io, asBase::ThreadPool* _pool, const std::function<void()>& _onWritten, const std::shared_ptr<SessionJournal>& _journal, const Voice& _voice)
 {
-	std::vector<AudioDeviceInfo> audioDevices;
-	getAudioInputs(audioDevices);
+	_data->trimStart(_noiseFloor * g_noiseFloorFactor);
+	_data->trimEnd(_noiseFloor * g_noiseFloorFactor);
 
-	std::vector<PaDeviceIndex> matchingDevices;
-	matchingDevices.reserve(audioDevices.size());
-	
-	for (auto i = 0; i < audioDevices.size(); ++i)
+	SessionJournal::Entry entry;
+
+	if(_journal)
 	{
-		const auto& devInfo = audioDevices[i];
+		entry.note = _voice.note;
+		entry.velocity = _voice.velocity;
+		entry.program = _voice.program;
+		entry.channel = _voice.channel;
+		entry.size = _data->dataSize();
+		entry.checksum = SessionJournal::crc32(_data->data(), _data->dataSize());
+		entry.filename = _filename;
+	}
 
-		if(devInfo.maxChannels <= m_config.inputChannels)
-			continue;
+	if(!_data->empty())
+	{
+		LOG("Writing file " << _filename);
 
-		if(!m_config.inputDevice.empty() && !strequal(m_config.inputDevice, devInfo.name) != 0)
-			continue;
+		const auto async = _onWritten && FileWriter::isAsync(_io);
 
-		if(!m_config.inputHostApi.empty() && !strequal(m_config.inputHostApi, devInfo.api) != 0)
-			continue;
+		FileWriter::Completion onComplete;
 
-		LOG("Audio Input Device " << i << " [" << devInfo.api << "]: " << devInfo.name << ", default samplerate " << devInfo.maxSamplerate << ", max input channels " << devInfo.maxChannels)
+		if(async)
+		{
+			onComplete = [_onWritten, _journal, entry](const bool _success)
+			{
+				if(_success && _journal)
+					_journal->add(entry);
+				_onWritten();
+			};
+		}
 
-		matchingDevices.push_back(devInfo.id);
-	}
+		const auto writeRes = FlacWriter::isFlacFilename(_filename)
+			? FlacWriter::write(_filename, _data->data(), _data->dataSize(), _data->getSampleFormat(), static_cast<int>(_data->getChannelCount()), static_cast<int>(_samplerate), _pool, _io, onComplete)
+			: WavWriter::write(_filename, _data->data(), _data->dataSize(), _data->getBitsPerSample(), _data->getIsFloat(), static_cast<int>(_data->getChannelCount()), static_cast<int>(_samplerate), nullptr, _io, onComplete);
+		if(!writeRes)
+		{
+			LOG_ERROR("Failed to create file " << _filename);
+			throw Error(ErrFileIO, "Failed to create file " + _filename);
+		}
 
-	if(matchingDevices.empty())
-	{
-		throw Error(ErrInputDeviceNotFound, "No input device found");
+		if(!async && _journal)
+			_journal->add(entry);
+
+		return async;
 	}
 
-	const auto& device = matchingDevices.back();
+	LOG("Skipping file " << _filename << " as it is completely silent");
+
+	// silent takes are complete as well, they are not sampled again
+	if(_journal)
+		_journal->add(entry);
+
+	return false;
+}
+
+void AutoSampler::beginStreamTake(Part& _part)
+{
+	const auto& filename = _part.filename;
 
-	PaStreamParameters inputParameters{};
-	inputParameters.channelCount = m_config.inputChannels;
-	inputParameters.device = device;
-	inputParameters.sampleFormat = bitCountToSampleFormat(m_config.inputBits);
+	_part.streamWriter.reset(new WavWriter());
 
-	auto err=  Pa_IsFormatSupported(&inputParameters, nullptr, m_config.inputSamplerate);
+	if(!_part.streamWriter->open(filename, _part.audioData->getBitsPerSample(), _part.audioData->getIsFloat(), static_cast<int>(_part.channelCount), static_cast<int>(m_samplerate)))
+	{
+		_part.streamWriter.reset();
+		throw Error(ErrFileIO, "Failed to create file " + filename);
+	}
 
-	if(err != paNoError)
-		throw Error(ErrAudioInput, std::string("Audio Input subsystem returned error: ") + Pa_GetErrorText(err));
+	_part.streamHasSignal = false;
+}
 
-	const auto streamFlags = (inputParameters.sampleFormat == paFloat32) ? paClipOff : paNoFlag;
+void AutoSampler::streamAudio(Part& _part, const void* _input, const size_t _frameCount)
+{
+	const auto* data = getPartInput(_part, _input, _frameCount);
+	const auto offset = _part.streamWriter->getFrameCount();
 
-	err = Pa_OpenStream(&m_inputStream, &inputParameters, nullptr, m_config.inputSamplerate, m_config.inputBlockSize, streamFlags, portAudioCallback, this);
+	if(!_part.streamWriter->appendFrames(data, _frameCount))
+		throw Error(ErrFileIO, "Failed to write to file " + _part.streamWriter->getFilename());
 
-	if(err != paNoError)
-		throw Error(ErrAudioInput, std::string("Audio Input subsystem returned error: ") + Pa_GetErrorText(err));
+	// track the audible range so that we can trim the file once the take is complete
+	const auto threshold = _part.noiseFloor * g_noiseFloorFactor;
+	const auto format = _part.audioData->getSampleFormat();
+	const auto sampleCount = _frameCount * _part.channelCount;
 
-	const auto* streamInfo = Pa_GetStreamInfo(m_inputStream);
+	size_t index;
 
-	// I've seen that the SR is something different than we wanted, check it
-	if(static_cast<int>(streamInfo->sampleRate) != m_config.inputSamplerate)
+	if(!_part.streamHasSignal && SampleConverter::findFirstAbove(format, data, sampleCount, threshold, index))
 	{
-		std::stringstream ss; ss << "Failed to set samplerate, requested was " << m_config.inputSamplerate << " but we've got " << streamInfo->sampleRate;
-		throw Error(ErrAudioInput, ss);
+		_part.streamFirstAudibleFrame = offset + index / _part.channelCount;
+		_part.streamHasSignal = true;
 	}
-	
-	m_samplerate = static_cast<float>(streamInfo->sampleRate);
 
-	m_audioData.reset(new AudioData(inputParameters.sampleFormat, inputParameters.channelCount));
+	if(_part.streamHasSignal && SampleConverter::findLastAbove(format, data, sampleCount, threshold, index))
+		_part.streamLastAudibleFrame = offset + index / _part.channelCount;
+
+	if(!_part.takeClipped && SampleConverter::peak(format, data, sampleCount) >= getClipLevel(format))
+		_part.takeClipped = true;
 }
 
-void AutoSampler::initMidiOutput()
+void AutoSampler::finishStreamTake(Part& _part)
 {
-	std::vector<DeviceInfo> midiDevices;
-	getMidiOutputs(midiDevices);
+	auto writer = _part.streamWriter;
+	_part.streamWriter.reset();
 
-	std::vector<int> matchingDevices;
+	auto journal = m_journal;
 
-	for(auto i=0; i<midiDevices.size(); ++i)
-	{
-		const auto& devInfo = midiDevices[i];
+	SessionJournal::Entry entry;
 
-		if(!m_config.midiOutputDevice.empty() && !strequal(m_config.midiOutputDevice, devInfo.name) != 0)
-			continue;
+	if(journal)
+	{
+		const auto& voice = m_voices[m_currentVoice];
 
-		if(!m_config.midiOutputApi.empty() && !strequal(m_config.midiOutputApi, devInfo.api) != 0)
-			continue;
+		entry.note = voice.note;
+		entry.velocity = voice.velocity;
+		entry.program = voice.program;
+		entry.channel = _part.midiChannel;
+		entry.filename = writer->getFilename();
+	}
 
-		LOG("MIDI device " << i << ": [" << devInfo.api << "]: " << devInfo.name);
+	if(!_part.streamHasSignal)
+	{
+		LOG("Skipping file " << writer->getFilename() << " as it is completely silent");
+		writer->discard();
 
-		matchingDevices.push_back(devInfo.id);
+		if(journal)
+			journal->add(entry);
+		return;
 	}
 
-	if(matchingDevices.empty())
-		throw Error(ErrMidiOutputNotFound, "No matching midi output device found");
+	// keep one frame of silence on both ends
+	const auto first = _part.streamFirstAudibleFrame > 0 ? _part.streamFirstAudibleFrame - 1 : 0;
+	const auto end = std::min(_part.streamLastAudibleFrame + 2, writer->getFrameCount());
 
-	const auto& device = matchingDevices.back();
+	m_writerPool->push([writer, first, end, journal, entry]
+	{
+		LOG("Writing file " << writer->getFilename());
+
+		if(!writer->finalize(first, end - first))
+			throw Error(ErrFileIO, "Failed to write file " + writer->getFilename());
+
+		if(!journal)
+			return;
 
-	const auto err = Pm_OpenOutput(&m_outputStream, device, nullptr, 64, nullptr, nullptr, 0);
+		// the audio data has been streamed to disk, it is read back to calculate the checksum
+		auto e = entry;
+		e.size = writer->getDataSize();
 
-	if(err != pmNoError)
-		throw Error(ErrMidiOutput, std::string("Midi Output subsystem returned error: ") + Pm_GetErrorText(err));
+		if(SessionJournal::crc32(e.filename, writer->getDataOffset(), e.size, e.checksum))
+			journal->add(e);
+		else
+			LOG_ERROR("Failed to read back file " << e.filename << ", it is not added to the session journal");
+	});
 }
 
-void AutoSampler::sendMidi(uint8_t a, uint8_t b, uint8_t c) const
+namespace
 {
-	if(!m_outputStream)
-		return;
+	FilenameTemplate::Values toTemplateValues(const AutoSampler::Voice& _voice, const int _device)
+	{
+		FilenameTemplate::Values values;
+
+		values.program = _voice.program == g_programChangeNone ? 0 : _voice.program;
+		values.note = _voice.note;
+		values.velocity = _voice.velocity;
+		values.channel = _voice.channel;
+		values.round = _voice.round;
+		values.layer = _voice.layer;
+		values.controllers = _voice.controllers;
+		values.device = _device;
+
+		return values;
+	}
+}
 
-	a &= 0xf0;
-	a |= m_config.midiChannel & 0x0f;
-	
-	const auto err = Pm_WriteShort(m_outputStream, 0, Pm_Message(a,b,c));
+void AutoSampler::createFilename(std::string& _result, const FilenameTemplate& _template, const Voice& _voice, const int _device/* = 0*/)
+{
+	_template.render(_result, toTemplateValues(_voice, _device));
+}
+
+std::string AutoSampler::createFilename(const FilenameTemplate& _template, const Voice& _voice, const int _device/* = 0*/)
+{
+	return _template.render(toTemplateValues(_voice, _device));
+}
 
-	if(err != pmNoError)
-		throw Error(ErrMidiOutput, std::string("Midi Output subsystem returned error: ") + Pm_GetErrorText(err));
+bool AutoSampler::getAudioInputs(std::vector<AudioDeviceInfo>& _audioInputs)
+{
+	return PortAudioSource::getDevices(_audioInputs);
 }
 
-void AutoSampler::setState(State _state)
+bool AutoSampler::getMidiOutputs(std::vector<DeviceInfo>& _midiOutputs)
 {
-	if(_state == m_state)
-		return;
+	return PortMidiSink::getDevices(_midiOutputs);
+}
 
-	m_state = _state;
-	m_stateDurationInFrames = 0;
+bool AutoSampler::audioInputCallback(const void* _input, size_t _frameCount, const double _inputAdcTime, const bool _deviceOverflow)
+{
+	// runs on the real-time audio thread, do not do anything else than handing the data to the capture thread
+	if(m_captureFinished)
+		return false;
 
-	switch (_state)
+	// some host APIs do not provide timing information
+	if(_inputAdcTime > 0.0)
 	{
-	case DetectNoiseFloor:
-		LOG("Detecting noise floor...");
-		m_audioData->clear();
-		break;
-	case PauseBefore:
-		{
-			m_audioData->clear();
+		const TimeAnchor anchor{m_callbackFramePosition, _inputAdcTime};
+		m_timeAnchors->write(&anchor, 1);
+	}
 
-			auto program = m_voices[m_currentVoice].program;
+	if(_deviceOverflow)
+	{
+		const InputOverflow overflow{m_callbackFramePosition, true};
+		m_inputOverflows->write(&overflow, 1);
+	}
 
-			if(program != g_programChangeNone)
-			{
-				if(m_currentVoice == 0 || program != m_voices[m_currentVoice-1].program)
-				{
-					LOG("Sending program change " << static_cast<int>(program));
-					sendMidi(M_PROGRAMCHANGE, program, 0);
-				}
-			}
-		}
-		break;
-	case Sustain:
-		{
-			const auto& voice = m_voices[m_currentVoice];
+	const auto written = m_inputBuffer->write(_input, _frameCount);
 
-			m_audioData->clear();
-			auto note = voice.note;
-			auto velocity = voice.velocity;
-			LOG("Sending Note ON for note " << noteToString(note) << " (" << static_cast<int>(note) << "), velocity " << static_cast<int>(velocity));
-			sendMidi(M_NOTEON, note, velocity);
-		}
-		break;
-	case Release:
-		{
-			const auto& voice = m_voices[m_currentVoice];
-			auto note = voice.note;
+	m_callbackFramePosition += written;
 
-			LOG("Sending Note off for note " << noteToString(note) << " (" << static_cast<int>(note) << "), release velocity " << static_cast<int>(m_config.releaseVelocity));
-			sendMidi(M_NOTEOFF, note, m_config.releaseVelocity);
-		}
-		break;
-	case PauseAfter:
-		{
-			auto* data = m_audioData->clone();
+	if(written < _frameCount)
+	{
+		const InputOverflow overflow{m_callbackFramePosition, false};
+		m_inputOverflows->write(&overflow, 1);
+		++m_inputOverflowCount;
+	}
+
+	return true;
+}
+
+void AutoSampler::captureThreadFunc()
+{
+	const auto idleMicroseconds = std::max(1000, static_cast<int>(500000.0f * static_cast<float>(m_config.inputBlockSize) / m_samplerate));
 
-			PendingWrite pendingWrite;
+	// the input buffer needs to be drained in time, drop log messages instead of waiting for the output
+	asBase::setLogRealtimeThread(true);
+
+	try
+	{
+		while(!m_captureFinished)
+		{
+			const void* data1;
+			const void* data2;
+			size_t size1, size2;
 
-			pendingWrite.data.reset(data);
-			pendingWrite.thread.reset(new std::thread(&AutoSampler::writeWaveFile, this, pendingWrite.data.get(), m_voices[m_currentVoice]));
+			const auto count = m_inputBuffer->getReadRegions(m_inputBuffer->capacity(), data1, size1, data2, size2);
 
+			if(!count)
 			{
-				std::lock_guard<std::mutex> lockPendingWrites(m_lockPendingWrites);
-				m_pendingWrites.insert(std::make_pair(data, pendingWrite));
+				// sources that are not driven by a device render the next block on demand
+				if(!m_audioSource->pull())
+					std::this_thread::sleep_for(std::chrono::microseconds(idleMicroseconds));
+				continue;
 			}
 
-			m_audioData->clear();
-		}
-		break;
-	case Finished: 
-		break;
-	default:;
-	}
-}
+			auto wantMore = processRegion(data1, size1);
 
-void AutoSampler::writeWaveFile(AudioData* _data, const Voice& voice)
-{
-	const auto filename = createFilename(voice);
-	
-	createDirectoryRecursive(filename);
+			if(wantMore && size2 > 0)
+				wantMore = processRegion(data2, size2);
 
-	_data->trimStart(m_noiseFloor * g_noiseFloorFactor);
-	_data->trimEnd(m_noiseFloor * g_noiseFloorFactor);
+			m_inputBuffer->advanceReadIndex(count);
 
-	if(!_data->empty())
-	{
-		LOG("Writing file " << filename);
-		const auto writeRes = WavWriter::write(filename, _data->data(), _data->getBitsPerSample(), _data->getIsFloat(), static_cast<int>(_data->getChannelCount()), static_cast<int>(m_samplerate), nullptr);
-		if(!writeRes)
-		{
-			LOG("Failed to create file " << filename);
-			throw Error(ErrFileIO, "Failed to create file " + filename);
+			if(!wantMore)
+				m_captureFinished = true;
 		}
 	}
-	else
+	catch(...)
 	{
-		LOG("Skipping file " << filename << " as it is completely silent");
+		m_captureError = std::current_exception();
+		m_captureFinished = true;
 	}
-
-	std::lock_guard<std::mutex> lockPendingWrites(m_lockPendingWrites);
-	auto it = m_pendingWrites.find(_data);
-	assert(it != m_pendingWrites.end());
-	it->second.data.reset();	
 }
 
-std::string AutoSampler::createFilename(const Voice& voice) const
+void AutoSampler::processTimeAnchors()
 {
-	auto program = m_config.programChanges.empty() ? 0 : voice.program;
-	auto note = voice.note;
-	auto velocity = voice.velocity;
+	// we only need the most recent one
+	auto received = false;
+
+	while(m_timeAnchors->read(&m_timeAnchor, 1))
+		received = true;
 
-	auto filename = m_config.filename;
+	if(!received)
+		return;
 
+	if(!m_timeAnchorValid)
 	{
-		std::stringstream ss; ss << std::setw(3) << std::setfill('0') << static_cast<int>(program);
-		strreplace(filename, "{program}", ss.str());
+		m_firstTimeAnchor = m_timeAnchor;
+		m_timeAnchorValid = true;
+		return;
 	}
+
+	// the sample clock of the device drifts against the clock of the audio source, which is shared by all devices of a session.
+	// Measure the actual samplerate over a long time span to schedule MIDI events precisely
+	const auto seconds = m_timeAnchor.adcTime - m_firstTimeAnchor.adcTime;
+
+	if(seconds < g_clockMeasureSeconds)
+		return;
+
+	const auto samplerate = static_cast<double>(m_timeAnchor.framePosition - m_firstTimeAnchor.framePosition) / seconds;
+
+	if(std::fabs(samplerate / static_cast<double>(m_samplerate) - 1.0) <= g_maxClockDeviation)
+		m_measuredSamplerate = samplerate;
+}
+
+bool AutoSampler::isTakeClipped() const
+{
+	for(const auto& part : m_parts)
 	{
-		std::stringstream ss; ss << std::setw(3) << std::setfill('0') << static_cast<int>(note);
-		strreplace(filename, "{note}", ss.str());
+		// streamed takes are checked while they are recorded
+		if(part.takeClipped || (!m_config.streamToDisk && part.audioData->peak() >= getClipLevel(part.audioData->getSampleFormat())))
+			return true;
 	}
+	return false;
+}
+
+double AutoSampler::getClockDriftPpm() const
+{
+	return (m_measuredSamplerate / static_cast<double>(m_samplerate) - 1.0) * 1000000.0;
+}
+
+void AutoSampler::processInputOverflows()
+{
+	// attribute overflows that the audio callback reported to the state that is active when we reach their stream position
+	while(true)
 	{
-		std::stringstream ss; ss << std::setw(3) << std::setfill('0') << static_cast<int>(velocity);
-		strreplace(filename, "{velocity}", ss.str());
+		const void* data1;
+		const void* data2;
+		size_t size1, size2;
+
+		if(!m_inputOverflows->getReadRegions(1, data1, size1, data2, size2))
+			break;
+
+		const auto overflow = *static_cast<const InputOverflow*>(data1);
+
+		if(overflow.framePosition > m_captureFramePosition)
+			break;
+
+		m_inputOverflows->advanceReadIndex(1);
+
+		// dropped frames do not advance the stream position, restart the samplerate measurement
+		m_firstTimeAnchor = m_timeAnchor;
+
+		if(m_state != Sustain && m_state != Release)
+			continue;
+
+		if(overflow.device)
+			++m_takeDeviceOverflowCount;
+		else
+			++m_takeInputOverflowCount;
 	}
+}
 
-	strreplace(filename, "{key}", noteToString(note));
+void AutoSampler::sendProgramChange(const int _program)
+{
+	if(_program == g_programChangeNone || _program == m_program)
+		return;
+
+	LOG("Sending program change " << _program);
+	sendMidi(M_PROGRAMCHANGE, static_cast<uint8_t>(_program), 0);
 
-	return filename;
+	m_program = _program;
+	m_programChangeFramePosition = m_captureFramePosition;
 }
 
-bool AutoSampler::getAudioInputs(std::vector<AudioDeviceInfo>& _audioInputs)
+size_t AutoSampler::getPauseBeforeLength() const
 {
-	initApis();
-	
-	const auto devCount = Pa_GetDeviceCount();
+	if(!m_config.adaptivePauses)
+		return m_pauseBefore;
 
-	if(devCount < 0)
-		return false;
+	// the device needs pause-before to switch programs. If the program change has been sent during the previous pause,
+	// only the remaining time is needed, otherwise just enough to schedule the note on ahead of time
+	const auto stateStart = m_captureFramePosition - m_stateDurationInFrames;
+	const auto sinceProgramChange = static_cast<size_t>(stateStart - m_programChangeFramePosition);
 
-	_audioInputs.reserve(devCount);
+	return std::max(m_minPause, m_pauseBefore > sinceProgramChange ? m_pauseBefore - sinceProgramChange : 0);
+}
+
+size_t AutoSampler::getPauseAfterLength() const
+{
+	if(!m_config.adaptivePauses)
+		return m_pauseAfter;
+
+	// an adaptive release already waited for the signal to decay
+	if(m_releaseDecayed)
+		return 0;
 
-	for (auto i = 0; i < devCount; ++i)
+	return std::min(m_pauseAfter, m_tailEnd + m_releaseHoldTime);
+}
+
+void AutoSampler::processTail(const void* _input, const size_t _frameCount)
+{
+	// extend the release/pause as long as the signal of any part is above its noise floor
+	for(auto& part : m_parts)
 	{
-		const auto* devInfo = Pa_GetDeviceInfo(i);
-		const auto* hostApi = Pa_GetHostApiInfo(devInfo->hostApi);
+		const auto* data = getPartInput(part, _input, _frameCount);
 
-		if(devInfo->maxInputChannels <= 0)
-			continue;
+		size_t index;
+
+		if(SampleConverter::findLastAbove(part.audioData->getSampleFormat(), data, _frameCount * part.channelCount, part.noiseFloor * g_noiseFloorFactor, index))
+			m_tailEnd = std::max(m_tailEnd, m_stateDurationInFrames + index / part.channelCount + 1);
+	}
+}
 
-		AudioDeviceInfo di;
-		
-		di.name = devInfo->name;
-		di.api = hostApi->name;
-		di.id = i;
+const void* AutoSampler::getPartInput(Part& _part, const void* _input, const size_t _frameCount) const
+{
+	if(!_part.inputChunk)
+		return _input;
 
-		di.maxChannels = devInfo->maxInputChannels;
-		di.maxSamplerate = static_cast<int>(devInfo->defaultSampleRate);
+	_part.inputChunk->clear();
+	_part.inputChunk->append(_input, _frameCount, m_channelCount, _part.firstChannel);
 
-		_audioInputs.emplace_back(std::move(di));
+	return _part.inputChunk->data();
+}
+
+size_t AutoSampler::getStateLength(const State _state) const
+{
+	switch (_state)
+	{
+	case DetectNoiseFloor:	return m_detectNoiseFloorDuration;
+	case PauseBefore:		return getPauseBeforeLength();
+	case Sustain:			return m_sustainLength;
+	case Release:			return m_config.adaptiveRelease ? std::min(m_releaseLength, m_tailEnd + m_releaseHoldTime) : m_releaseLength;
+	case PauseAfter:		return getPauseAfterLength();
+	default:				return 0;
 	}
+}
 
-	return true;
+bool AutoSampler::isRecordingState(const State _state)
+{
+	return _state == DetectNoiseFloor || _state == Sustain || _state == Release;
 }
 
-bool AutoSampler::getMidiOutputs(std::vector<DeviceInfo>& _midiOutputs)
+bool AutoSampler::processRegion(const void* _input, size_t _frameCount)
 {
-	initApis();
+	// a region can hold seconds of audio if the capture thread fell behind. Processing it in slices of one block keeps the
+	// input chunks of the parts within their reserved size, they are never reallocated while recording
+	const auto* input = static_cast<const uint8_t*>(_input);
+	const auto bytesPerFrame = getSampleSize(toSampleFormat(m_sampleFormat)) * m_channelCount;
+	const auto blockSize = static_cast<size_t>(m_config.inputBlockSize);
+
+	while(_frameCount > 0)
+	{
+		const auto count = std::min(_frameCount, blockSize);
 
-	const auto devCount = Pm_CountDevices();
+		if(!processAudio(input, count))
+			return false;	// stop
 
-	if(devCount < 0)
-		return false;
+		input += count * bytesPerFrame;
+		_frameCount -= count;
+	}
 
-	std::vector<int> matchingDevices;
+	return true;	// want more
+}
 
-	for(auto i=0; i<devCount; ++i)
+bool AutoSampler::processAudio(const void* _input, size_t _frameCount)
+{
+	// split the block at the exact frame at which the current state ends so that the timing does not depend on the block size
+	const auto* input = static_cast<const uint8_t*>(_input);
+	const auto bytesPerFrame = getSampleSize(toSampleFormat(m_sampleFormat)) * m_channelCount;
+
+	processTimeAnchors();
+
+	while(m_state != Finished)
 	{
-		const auto* devInfo = Pm_GetDeviceInfo(i);
+		const auto stateLength = getStateLength(m_state);
+		const auto remaining = stateLength > m_stateDurationInFrames ? stateLength - m_stateDurationInFrames : 0;
+		const auto count = std::min(remaining, _frameCount);
 
-		if(!devInfo->output)
-			continue;
+		if(count > 0)
+		{
+			m_captureFramePosition += count;
+			asBase::setLogFramePosition(m_captureFramePosition);
+			processInputOverflows();
+
+			for(auto& part : m_parts)
+			{
+				if(part.streamWriter)
+					streamAudio(part, input, count);
+				else if(isRecordingState(m_state))
+					part.audioData->append(input, count, m_channelCount, part.firstChannel);
+			}
+
+			if((m_state == Release && m_config.adaptiveRelease) || (m_state == PauseAfter && m_config.adaptivePauses))
+				processTail(input, count);
 
-		DeviceInfo di;
-		di.name = devInfo->name;
-		di.api = devInfo->interf;
-		di.id = i;
+			m_stateDurationInFrames += count;
 
-		_midiOutputs.emplace_back(std::move(di));
+			input += count * bytesPerFrame;
+			_frameCount -= count;
+		}
+
+		// the length of an adaptive release/pause grows while the signal is audible, continue with the rest of the block
+		if(m_stateDurationInFrames < getStateLength(m_state))
+		{
+			if(!_frameCount)
+				return true;	// want more
+			continue;
+		}
+
+		onStateFinished();
 	}
-	return true;
+
+	return false;	// stop
 }
 
-bool AutoSampler::audioInputCallback(const void* _input, size_t _frameCount)
+void AutoSampler::onStateFinished()
 {
-	m_stateDurationInFrames += _frameCount;
-	
 	switch (m_state)
 	{
 		case DetectNoiseFloor:
-			m_audioData->append(_input, _frameCount);
-
-			if(m_stateDurationInFrames >= m_detectNoiseFloorDuration)
 			{
-				float gain = 0.0f;
-
-				for(size_t f=0; f<m_audioData->lengthInFrames(); ++f)
+				for(auto& part : m_parts)
 				{
-					for(size_t c=0; c<m_audioData->getChannelCount(); ++c)
+					part.noiseFloor = part.audioData->peak();
+
+					if(m_parts.size() > 1)
+					{
+						LOG("Noise floor of MIDI channel " << static_cast<int>(part.midiChannel) << " is " << part.noiseFloor);
+					}
+					else
 					{
-						const auto g = std::abs(m_audioData->floatValue(f, c));
-						gain = std::max(g, gain);						
+						LOG("Noise floor is " << part.noiseFloor);
 					}
 				}
-
-				LOG("Noise floor is " << gain);
-				m_noiseFloor = gain;
-				setState(PauseBefore);
+				m_sessionStartFramePosition = m_captureFramePosition;
+				setState(m_voices.empty() ? Finished : PauseBefore);
 			}
 			break;
 		case PauseBefore:
-			if(m_stateDurationInFrames >= m_pauseBefore)
-				setState(Sustain);
+			setState(Sustain);
 			break;
 		case Sustain:
-			m_audioData->append(_input, _frameCount);
-			if(m_stateDurationInFrames >= m_sustainLength)
-				setState(Release);
+			setState(Release);
 			break;
 		case Release:
-			m_audioData->append(_input, _frameCount);
-			if(m_stateDurationInFrames >= m_releaseLength)
-				setState(PauseAfter);
-			break;
-		case PauseAfter:
-			if(m_stateDurationInFrames >= m_pauseAfter)
+			if(m_config.adaptiveRelease)
 			{
-				++m_currentVoice;
-				if(m_currentVoice < m_voices.size())
-					setState(PauseBefore);
-				else
-					setState(Finished);
+				LOG("Release finished after " << (static_cast<float>(m_stateDurationInFrames) / m_samplerate) << " seconds");
+				m_releaseDecayed = m_stateDurationInFrames < m_releaseLength;
 			}
+			setState(PauseAfter);
 			break;
-		case Finished:
-			return false;	// stop
+		case PauseAfter:
+			++m_currentVoice;
+			if(m_currentVoice < m_voices.size())
+				setState(PauseBefore);
+			else
+				setState(Finished);
+			break;
+		default:;
 	}
+}
 
-	return true;	// want more
+void AutoSampler::createParts()
+{
+	auto mappings = m_config.channelMap;
+
+	if(mappings.empty())
+	{
+		ChannelMapping mapping;
+		mapping.midiChannel = m_config.midiChannel;
+		mapping.firstInputChannel = 0;
+		mapping.inputChannelCount = static_cast<int>(m_channelCount);
+		mappings.push_back(mapping);
+	}
+
+	// pools are per part as the channel count may differ
+	// asynchronous writes keep their buffers until the file has been closed
+	const auto poolSize = m_config.streamToDisk ? 1 : m_config.writerThreads + m_config.writerQueueSize * (m_config.fileIO == FileIOUring ? 2 : 1) + 1;
+	const auto takeLength = m_config.streamToDisk ? m_detectNoiseFloorDuration : std::max(m_sustainLength + m_releaseLength, m_detectNoiseFloorDuration);
+
+	m_parts.reserve(mappings.size());
+
+	for(const auto& mapping : mappings)
+	{
+		if(mapping.firstInputChannel < 0 || mapping.inputChannelCount < 1 || static_cast<size_t>(mapping.firstInputChannel + mapping.inputChannelCount) > m_channelCount)
+		{
+			std::stringstream ss;
+			ss << "Input channels " << mapping.firstInputChannel << "-" << (mapping.firstInputChannel + mapping.inputChannelCount - 1) << " of MIDI channel " << static_cast<int>(mapping.midiChannel) << " are not available, the audio input has " << m_channelCount << " channels";
+			throw Error(ErrAudioInput, ss.str());
+		}
+
+		Part part;
+		part.midiChannel = mapping.midiChannel;
+		part.firstChannel = static_cast<size_t>(mapping.firstInputChannel);
+		part.channelCount = static_cast<size_t>(mapping.inputChannelCount);
+
+		// one buffer is being recorded, the others are in the queue or being written
+		part.audioDataPool.reset(new AudioDataPool(m_sampleFormat, part.channelCount, takeLength, poolSize));
+		part.audioData = part.audioDataPool->acquire();
+
+		if(part.channelCount != m_channelCount)
+		{
+			part.inputChunk.reset(new AudioData(m_sampleFormat, part.channelCount));
+			part.inputChunk->reserve(m_config.inputBlockSize);
+		}
+
+		m_parts.push_back(std::move(part));
+	}
+
+	if(m_parts.size() > 1)
+	{
+		for(const auto& part : m_parts)
+			LOG("Recording MIDI channel " << static_cast<int>(part.midiChannel) << " from input channels " << part.firstChannel << "-" << (part.firstChannel + part.channelCount - 1));
+	}
+}
+
+void AutoSampler::createDirectories() const
+{
+	// all directories are known up front, writers do not need to check them for every file
+	DirectoryCache directories;
+	std::string filename;
+
+	for(const auto& voice : m_voices)
+	{
+		for(const auto& part : m_parts)
+		{
+			createFilename(filename, voice, part);
+			directories.createDirectories(filename);
+		}
+	}
 }
 
 void AutoSampler::generateVoices()
 {
+	std::vector<Voice> voices;
+
 	Voice voice;
 
-	auto permutateNoteAndVelocity = [&]()
+	const auto programs = m_config.programChanges.empty() ? std::vector<uint8_t>{g_programChangeNone} : m_config.programChanges;
+
+	const auto roundRobins = static_cast<size_t>(std::max(1, m_config.roundRobins));
+
+	voices.reserve(programs.size() * m_config.velocities.size() * roundRobins * m_config.noteNumbers.size());
+
+	for(auto p : programs)
 	{
-		for(auto v : m_config.velocities)
+		voice.program = p;
+
+		for(size_t v=0; v<m_config.velocities.size(); ++v)
 		{
-			voice.velocity = v;
+			voice.velocity = m_config.velocities[v];
+			voice.layer = static_cast<int>(v);
 
-			for(auto n : m_config.noteNumbers)
+			for(size_t r=0; r<roundRobins; ++r)
 			{
-				voice.note = n;
+				voice.round = static_cast<int>(r);
 
-				if(m_config.skipExistingFiles)
+				for(auto n : m_config.noteNumbers)
 				{
-					const auto filename = createFilename(voice);
-
-					FILE* hFile = fopen(filename.c_str(), "rb");
-					if(hFile)
-					{
-						fclose(hFile);
-						LOG("Skipping file " << filename << ", already exists")
-						continue;
-					}
+					voice.note = n;
+					voices.push_back(voice);
 				}
-
-				m_voices.push_back(voice);
 			}
-		}		
-	};
+		}
+	}
 
-	if(m_config.programChanges.empty())
+	if(!m_config.skipExistingFiles)
 	{
-		voice.program = g_programChangeNone;
-		permutateNoteAndVelocity();
+		m_voices = std::move(voices);
+		LOG(m_voices.size() << " total voices remaining");
+		return;
 	}
-	else
-	{	
-		for(auto p : m_config.programChanges)
+
+	// expand the filenames of all parts of all voices, in parallel for large sessions
+	const auto partCount = m_parts.size();
+	std::vector<std::string> filenames(voices.size() * partCount);
+
+	const auto chunkCount = (voices.size() + g_voiceChunkSize - 1) / g_voiceChunkSize;
+
+	auto expandChunk = [&](const size_t _chunk)
+	{
+		const auto end = std::min(voices.size(), (_chunk + 1) * g_voiceChunkSize);
+
+		for(auto i=_chunk * g_voiceChunkSize; i<end; ++i)
 		{
-			voice.program = p;
-			permutateNoteAndVelocity();
+			for(size_t p=0; p<partCount; ++p)
+				createFilename(filenames[i * partCount + p], voices[i], m_parts[p]);
 		}
+	};
+
+	if(chunkCount > 1)
+	{
+		m_writerPool->parallelFor(chunkCount, expandChunk);
 	}
+	else
+	{
+		for(size_t c=0; c<chunkCount; ++c)
+			expandChunk(c);
+	}
+
+	// a voice is recorded as long as the file of any part is missing. The journal knows which takes are complete,
+	// otherwise every directory is listed once
+	FileIndex index;
+
+	auto exists = [&](const std::string& _filename)
+	{
+		return m_journal ? m_journal->contains(_filename) : index.exists(_filename);
+	};
+
+	size_t skippedCount = 0;
+
+	for(size_t i=0; i<voices.size(); ++i)
+	{
+		size_t existingCount = 0;
+
+		while(existingCount < partCount && exists(filenames[i * partCount + existingCount]))
+			++existingCount;
+
+		if(existingCount == partCount)
+			++skippedCount;
+		else
+			m_voices.push_back(voices[i]);
+	}
+
+	if(skippedCount)
+		LOG("Skipping " << skippedCount << " voices, their files already exist");
 
-	std::cout << m_voices.size() << " total voices remaining" << std::endl;
+	LOG(m_voices.size() << " total voices remaining");
 }
 }
@@ -1,11 +1,27 @@
 #pragma once
 
-#include <map>
-#include <mutex>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <thread>
 
 #include "audioData.h"
+#include "audioDataPool.h"
+#include "audioSource.h"
 #include "config.h"
+#include "deviceInfo.h"
+#include "filenameTemplate.h"
+#include "sessionMetrics.h"
+#include "midiSink.h"
+#include "ringBuffer.h"
+#include "sessionJournal.h"
+#include "wavWriter.h"
+
+namespace asBase
+{
+	class ThreadPool;
+}
 
 namespace asLib
 {
@@ -22,57 +38,129 @@ class AutoSampler
 		Finished,
 	};
 
-	struct Voice
+	struct TimeAnchor
 	{
-		int note = -1;
-		int velocity = -1;
-		int program = -1;
+		uint64_t framePosition;
+		double adcTime;			// time in seconds at which the frame has been captured, clock of the audio source
 	};
 
-public:
-	struct DeviceInfo
+	struct InputOverflow
 	{
-		std::string name;
-		std::string api;
-		int id;
+		uint64_t framePosition;	// input has been lost before this frame
+		bool device;			// dropped by the audio device, otherwise the capture thread did not keep up
 	};
 
-	struct AudioDeviceInfo : DeviceInfo
+	// takes of all parts are recorded simultaneously, each one from its own range of input channels
+	struct Part
 	{
-		int maxChannels;
-		int maxSamplerate;
+		uint8_t midiChannel = 0;
+		size_t firstChannel = 0;
+		size_t channelCount = 0;
+
+		float noiseFloor = 0.0f;
+
+		std::shared_ptr<AudioDataPool> audioDataPool;	// shared with the writer jobs, they may outlive us if the writer pool is shared
+		AudioData* audioData = nullptr;			// take that is currently being recorded, owned by the pool
+		std::unique_ptr<AudioData> inputChunk;	// channels of this part extracted from the current input block, if the part does not use all of them
+
+		// streaming mode: takes are written to disk while they are recorded
+		std::shared_ptr<WavWriter> streamWriter;
+		bool streamHasSignal = false;
+		size_t streamFirstAudibleFrame = 0;
+		size_t streamLastAudibleFrame = 0;
+
+		bool takeClipped = false;				// a sample of the current take reached full scale, streaming mode only
+
+		std::string filename;					// of the current take, rendered once when it starts, the capacity is reused
 	};
 
-	explicit AutoSampler(Config _config);
+public:
+	typedef asLib::DeviceInfo DeviceInfo;
+	typedef asLib::AudioDeviceInfo AudioDeviceInfo;
+
+	struct Voice
+	{
+		int note = -1;
+		int velocity = -1;
+		int program = -1;
+		int channel = 0;
+		int round = 0;							// round robin
+		int layer = 0;							// index of the velocity
+		const uint8_t* controllers = nullptr;	// controller values when slicing, see MidiFile::getControllers
+		int retake = 0;							// number of times this voice has been recorded before and discarded
+	};
+
+	// the writer pool and the journal can be shared with other samplers of a session, a private journal is created if none is
+	// given. The owner of the pool waits for the files to be written, see Session::run
+	AutoSampler(Config _config, std::shared_ptr<asBase::ThreadPool> _writerPool, std::shared_ptr<SessionJournal> _journal = nullptr);
 	virtual ~AutoSampler();
+
+	// returns once this device has finished recording, its files might still be written
 	void run();
-	bool audioInputCallback(const void* _input, size_t _frameCount);
+	bool audioInputCallback(const void* _input, size_t _frameCount, double _inputAdcTime, bool _deviceOverflow);
 
-	void writeWaveFile(AudioData* _data, const Voice& voice);
+	// trims the data to the part that is above the noise floor and writes it, skips the file if the data is silent.
+	// Writes FLAC if the filename ends with .flac, the encoder uses the given pool to encode in parallel.
+	// The directory of _filename has to exist.
+	// Returns true if the file is written asynchronously, _data is in use until _onWritten is called. Otherwise the file
+	// has been written when this returns and _onWritten is not called. The take is added to the journal once it is complete
+	static bool writeWaveFile(const std::string& _filename, AudioData* _data, float _noiseFloor, float _samplerate, FileIO _io, asBase::ThreadPool* _pool, const std::function<void()>& _onWritten, const std::shared_ptr<SessionJournal>& _journal, const Voice& _voice);
 
-	std::string createFilename(const Voice& _voice) const;
-	std::string createFilename() const
-	{
-		return createFilename(m_voices[m_currentVoice]);
-	}
+	static void createFilename(std::string& _result, const FilenameTemplate& _template, const Voice& _voice, int _device = 0);
+	static std::string createFilename(const FilenameTemplate& _template, const Voice& _voice, int _device = 0);
 
 	static bool getAudioInputs(std::vector<AudioDeviceInfo>& _audioInputs);
 	static bool getMidiOutputs(std::vector<DeviceInfo>& _midiOutputs);
 	
 private:
-	void initAudioInput();
-	void initMidiOutput();
-	void sendMidi(uint8_t a, uint8_t b, uint8_t c) const;
+	void createFilename(std::string& _result, const Voice& _voice, const Part& _part) const
+	{
+		auto voice = _voice;
+		voice.channel = _part.midiChannel;
+		createFilename(_result, m_filenameTemplate, voice, m_config.deviceIndex);
+	}
+
+	void sendMidi(uint8_t a, uint8_t b, uint8_t c, double _time = 0.0) const;
+	void scheduleMidi(uint8_t a, uint8_t b, uint8_t c, uint64_t _framePosition) const;
+	bool canScheduleMidi() const { return m_timeAnchorValid; }
+	void sendNoteOn(uint64_t _framePosition);
+	void sendNoteOff(uint64_t _framePosition);
 	void setState(State _state);
 	void generateVoices();
+	void createDirectories() const;
+	void createParts();
+	const void* getPartInput(Part& _part, const void* _input, size_t _frameCount) const;
+
+	void captureThreadFunc();
+	bool processRegion(const void* _input, size_t _frameCount);
+	bool processAudio(const void* _input, size_t _frameCount);
+	void onStateFinished();
+	size_t getStateLength(State _state) const;
+	static bool isRecordingState(State _state);
+	void processInputOverflows();
+	void processTimeAnchors();
+	double getClockDriftPpm() const;
+	bool isTakeClipped() const;
+	void processTail(const void* _data, size_t _frameCount);
+	void sendProgramChange(int _program);
+	size_t getPauseBeforeLength() const;
+	size_t getPauseAfterLength() const;
+
+	void beginStreamTake(Part& _part);
+	void streamAudio(Part& _part, const void* _input, size_t _frameCount);
+	void finishStreamTake(Part& _part);
 
 	const Config m_config;
-	void* m_inputStream = nullptr;
-	void* m_outputStream = nullptr;
+	const FilenameTemplate m_filenameTemplate;
+	std::shared_ptr<AudioSource> m_audioSource;
+	std::shared_ptr<MidiSink> m_midiSink;
 
 	float m_samplerate;
 
-	std::unique_ptr<AudioData> m_audioData;
+	unsigned long m_sampleFormat = 0;
+	size_t m_channelCount = 0;
+
+	std::vector<Part> m_parts;						// does not change once created, writer jobs keep pointers to its elements
 
 	State m_state = Invalid;
 
@@ -82,20 +170,51 @@ private:
 	size_t m_pauseBefore = 0;
 	size_t m_sustainLength = 0;
 	size_t m_releaseLength = 0;
+	size_t m_releaseHoldTime = 0;
 	size_t m_pauseAfter = 0;
 
-	float m_noiseFloor = 0.0f;
+	size_t m_minPause = 0;
+
+	size_t m_tailEnd = 0;							// adaptive release/pauses: state relative position after the last audible frame
+	bool m_releaseDecayed = false;					// adaptive release ended before reaching its maximum length
+
+	int m_program = -1;								// last program change that has been sent
+	uint64_t m_programChangeFramePosition = 0;
+	uint64_t m_sessionStartFramePosition = 0;
 
 	std::vector<Voice> m_voices;
 	size_t m_currentVoice = 0;
 
-	struct PendingWrite
-	{
-		std::shared_ptr<std::thread> thread;
-		std::shared_ptr<AudioData> data;
-	};
+	// audio callback => capture thread
+	std::unique_ptr<RingBuffer> m_inputBuffer;
+	std::unique_ptr<RingBuffer> m_inputOverflows;	// stream positions at which the audio callback or the device dropped data
+
+	uint64_t m_callbackFramePosition = 0;			// audio callback only
+	uint64_t m_captureFramePosition = 0;			// capture thread only
+
+	std::unique_ptr<RingBuffer> m_timeAnchors;		// maps stream positions to capture time, used to schedule MIDI events
+
+	TimeAnchor m_timeAnchor{0, 0.0};
+	TimeAnchor m_firstTimeAnchor{0, 0.0};
+	bool m_timeAnchorValid = false;
+	double m_measuredSamplerate = 0.0;				// samplerate of the device measured against the clock of the audio source
+	bool m_noteOnSent = false;
+	bool m_noteOffSent = false;
+
+	std::atomic<uint32_t> m_inputOverflowCount{0};
+	size_t m_takeInputOverflowCount = 0;
+	size_t m_takeDeviceOverflowCount = 0;
+
+	std::unique_ptr<SessionMetrics> m_metrics;	// capture thread only
+	size_t m_retakeCount = 0;
+
+	std::atomic<bool> m_captureFinished{false};
+	std::thread m_captureThread;
+	std::exception_ptr m_captureError;
+
+	std::shared_ptr<SessionJournal> m_journal;
 
-	std::mutex m_lockPendingWrites;
-	std::map<const AudioData*,PendingWrite> m_pendingWrites;
+	// declared last, a private pool waits for its jobs when it is destroyed
+	std::shared_ptr<asBase::ThreadPool> m_writerPool;
 };
 }
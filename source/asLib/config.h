@@ -1,10 +1,37 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+#include "../asBase/logging.h"
+
 namespace asLib
 {
+// one part of a multitimbral device: played on its own MIDI channel, recorded from its own range of input channels
+struct ChannelMapping
+{
+	uint8_t midiChannel = 0;
+	int firstInputChannel = 0;
+	int inputChannelCount = 1;
+};
+
+// audio input and MIDI output of one device of a rack
+struct DevicePair
+{
+	std::string inputDevice;
+	std::string midiOutputDevice;
+};
+
+// how recordings that are completely in memory are written to disk
+enum FileIO
+{
+	FileIOStdio,		// buffered stdio
+	FileIOVectored,		// preallocated and written with a single pwritev, Linux only, stdio otherwise
+	FileIODirect,		// like FileIOVectored, but bypasses the page cache with O_DIRECT
+	FileIOUring,		// asynchronous, many files in flight with io_uring, FileIOVectored if it is not available
+};
+
 struct Config
 {
 	// Audio Input
@@ -19,12 +46,24 @@ struct Config
 	std::string midiOutputDevice;
 	std::string midiOutputApi;
 
+	// Devices that are sampled in parallel, each one records all voices. If empty, inputDevice and midiOutputDevice are used
+	std::vector<DevicePair> devices;
+	int deviceIndex = 0;				// device of a session that this config is for, rendered as {device}
+
+	// Virtual Instrument, replaces audio input and MIDI output
+	bool virtualInstrument = false;
+	float virtualAttack = 0.005f;
+	float virtualDecay = 1.0f;			// time until a released note has decayed by 60 dB
+	float virtualNoise = 0.0005f;
+
 	// Processing - MIDI
 	std::vector<uint8_t> noteNumbers;
 	std::vector<uint8_t> velocities = {127};
 	std::vector<uint8_t> programChanges;
+	int roundRobins = 1;				// number of times every note is recorded
 	uint8_t releaseVelocity = 0;
 	uint8_t midiChannel = 0;
+	std::vector<ChannelMapping> channelMap;	// records all parts simultaneously, if empty, midiChannel is recorded from all input channels
 
 	// Processing - Audio
 	float detectNoisefloorDuration = 2.0f;
@@ -34,8 +73,29 @@ struct Config
 	float releaseLength = 1.0f;
 	float pauseAfter = 0.5f;
 
+	bool adaptiveRelease = false;		// end the release once the signal decayed into the noise floor, releaseLength is the maximum
+	float releaseHoldTime = 0.25f;		// time the signal needs to stay below the noise floor to end the release
+	bool adaptivePauses = false;		// derive the pauses from the measured decay and program changes, pauseBefore/pauseAfter are the maximum
+
+	int retakeLimit = 2;				// takes with input overflows are recorded again up to this many times
+	bool retakeClipped = true;			// takes that clipped are recorded again as well
+
 	// I/O
 	std::string filename = "";
 	bool skipExistingFiles = true;
+	int writerThreads = 2;
+	int writerQueueSize = 4;
+	bool streamToDisk = false;
+	FileIO fileIO = FileIOStdio;
+	std::string journalFile;			// records completed takes, a session that is started again skips them without probing for files
+
+	// Logging
+	asBase::LogLevel logLevel = asBase::LogInfo;
+	std::string metricsFile;			// timing and overflow statistics are written here as JSON when the session has finished
+	bool metricsLive = false;			// log the statistics after every take
+
+	// Offline slicing, cuts an existing recording of a session instead of recording one
+	std::string sliceAudioFile;
+	std::string sliceMidiFile;
 };
 }
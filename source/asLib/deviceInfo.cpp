@@ -0,0 +1,26 @@
+#include "deviceInfo.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace asLib
+{
+static bool strequal(const std::string& _a, const std::string& _b)
+{
+    return _a.size() == _b.size() && std::equal(_a.cbegin(), _a.cend(), _b.cbegin(),[](const std::string::value_type& _a, const std::string::value_type& _b)
+    {
+		return toupper(_a) == toupper(_b);
+    });
+}
+
+bool DeviceInfo::matches(const std::string& _name, const std::string& _api) const
+{
+	if(!_name.empty() && !strequal(_name, name))
+		return false;
+
+	if(!_api.empty() && !strequal(_api, api))
+		return false;
+
+	return true;
+}
+}
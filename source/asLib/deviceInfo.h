@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+namespace asLib
+{
+	struct DeviceInfo
+	{
+		std::string name;
+		std::string api;
+		int id;
+
+		// case insensitive, an empty name or api matches any device
+		bool matches(const std::string& _name, const std::string& _api) const;
+	};
+
+	struct AudioDeviceInfo : DeviceInfo
+	{
+		int maxChannels;
+		int maxSamplerate;
+	};
+}
@@ -0,0 +1,76 @@
+#include "directoryCache.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+#include "error.h"
+
+namespace asLib
+{
+namespace
+{
+	bool makeDirectory(const std::string& _path)
+	{
+#ifdef _WIN32
+		return _mkdir(_path.c_str()) == 0;
+#else
+		return mkdir(_path.c_str(), 0755) == 0;
+#endif
+	}
+
+	bool isDirectory(const std::string& _path)
+	{
+		struct stat st;
+		return stat(_path.c_str(), &st) == 0 && (st.st_mode & S_IFMT) == S_IFDIR;
+	}
+}
+
+void DirectoryCache::createDirectories(const std::string& _filename)
+{
+	const auto end = _filename.find_last_of("/\\");
+
+	if(end == std::string::npos || end == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// common case, another file in the same directory has been written before
+	if(isKnown(_filename.substr(0, end)))
+		return;
+
+	for(size_t searchPos=0; searchPos <= end;)
+	{
+		const auto pos = _filename.find_first_of("/\\", searchPos);
+
+		const auto path = _filename.substr(0, pos);
+
+		searchPos = pos + 1;
+
+		// root directory or windows drive letter
+		if(path.empty() || path.back() == ':')
+			continue;
+
+		if(isKnown(path))
+			continue;
+
+		if(!makeDirectory(path))
+		{
+			const auto error = errno;
+
+			if(error != EEXIST)
+				throw Error(ErrFileIO, "Failed to create directory " + path + ": " + strerror(error));
+
+			if(!isDirectory(path))
+				throw Error(ErrFileIO, "Failed to create directory " + path + ", a file with that name exists");
+		}
+
+		m_existing.insert(path);
+	}
+}
+}
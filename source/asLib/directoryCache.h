@@ -0,0 +1,23 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace asLib
+{
+	// Creates the directories of output files. Every directory is created or checked once, further files in the same
+	// directory cost a single lookup instead of one mkdir call per path component
+	class DirectoryCache
+	{
+	public:
+		// creates all directories of the path of _filename that do not exist yet. Thread safe, throws if one cannot be created
+		void createDirectories(const std::string& _filename);
+
+	private:
+		bool isKnown(const std::string& _path) const	{ return m_existing.find(_path) != m_existing.end(); }
+
+		std::mutex m_mutex;
+		std::unordered_set<std::string> m_existing;
+	};
+}
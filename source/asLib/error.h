@@ -19,6 +19,7 @@ enum ErrorType
 	ErrMidiOutputNotFound,
 	ErrMidiOutput,
 	ErrFileIO,
+	ErrFileFormat,
 };
 
 class Error final : public std::runtime_error
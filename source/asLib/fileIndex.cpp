@@ -0,0 +1,79 @@
+#include "fileIndex.h"
+
+#ifdef _WIN32
+#include <algorithm>
+#include <cctype>
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace asLib
+{
+namespace
+{
+#ifdef _WIN32
+	// file names are not case sensitive on Windows
+	std::string normalize(std::string _name)
+	{
+		std::transform(_name.begin(), _name.end(), _name.begin(), [](const char _c) { return static_cast<char>(::tolower(static_cast<unsigned char>(_c))); });
+		return _name;
+	}
+#else
+	const std::string& normalize(const std::string& _name)
+	{
+		return _name;
+	}
+#endif
+}
+
+bool FileIndex::exists(const std::string& _filename)
+{
+	const auto pos = _filename.find_last_of("/\\");
+
+	if(pos == std::string::npos)
+		return getDirectory(".").count(normalize(_filename)) > 0;
+
+	const auto& directory = getDirectory(pos ? _filename.substr(0, pos) : _filename.substr(0, 1));
+
+	return directory.count(normalize(_filename.substr(pos + 1))) > 0;
+}
+
+const std::unordered_set<std::string>& FileIndex::getDirectory(const std::string& _path)
+{
+	auto it = m_directories.find(_path);
+
+	if(it != m_directories.end())
+		return it->second;
+
+	// a directory that does not exist is empty
+	auto& files = m_directories[_path];
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	const auto handle = FindFirstFileA((_path + "\\*").c_str(), &data);
+
+	if(handle != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+				files.insert(normalize(data.cFileName));
+		}
+		while(FindNextFileA(handle, &data));
+
+		FindClose(handle);
+	}
+#else
+	if(auto* dir = opendir(_path.c_str()))
+	{
+		while(const auto* entry = readdir(dir))
+			files.insert(entry->d_name);
+
+		closedir(dir);
+	}
+#endif
+
+	return files;
+}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace asLib
+{
+	// Answers whether files exist from a listing of their directory. Every directory is read once, checking thousands of
+	// files does not cost one file system access per file. Not thread safe
+	class FileIndex
+	{
+	public:
+		bool exists(const std::string& _filename);
+
+	private:
+		const std::unordered_set<std::string>& getDirectory(const std::string& _path);
+
+		std::unordered_map<std::string, std::unordered_set<std::string>> m_directories;
+	};
+}
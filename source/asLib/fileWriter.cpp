@@ -0,0 +1,740 @@
+#include "fileWriter.h"
+
+#include "../asBase/logging.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#endif
+
+#ifdef ASLIB_HAVE_IO_URING
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "../asBase/threadPool.h"
+#endif
+
+namespace asLib
+{
+namespace
+{
+	bool writeStdio(const std::string& _filename, const std::vector<FileWriter::Buffer>& _buffers)
+	{
+		FILE* handle = fopen(_filename.c_str(), "wb");
+
+		if(!handle)
+			return false;
+
+		auto res = true;
+
+		for(const auto& buffer : _buffers)
+		{
+			if(!res)
+				break;
+			res = fwrite(buffer.data, 1, buffer.size, handle) == buffer.size;
+		}
+
+		res = res && FileWriter::syncFile(handle);
+
+		return fclose(handle) == 0 && res;
+	}
+
+	// makes the rename of a file in the directory of _filename durable. Best effort, not every file system supports syncing
+	// directories. Windows has no equivalent, NTFS journals the rename
+	void syncDirectory(const std::string& _filename)
+	{
+#ifdef _WIN32
+		(void)_filename;
+#else
+		const auto pos = _filename.find_last_of('/');
+		const auto dir = pos == std::string::npos ? std::string(".") : _filename.substr(0, pos ? pos : 1);
+
+		const auto fd = ::open(dir.c_str(), O_RDONLY);
+
+		if(fd < 0)
+			return;
+
+		::fsync(fd);
+		::close(fd);
+#endif
+	}
+
+#ifdef __linux__
+	constexpr size_t g_directAlignment = 4096;		// multiple of the logical block size of all common devices
+	constexpr size_t g_directBufferSize = 1024 * 1024;
+
+	std::atomic<bool> g_directUnsupportedLogged{false};
+
+	struct FreeDeleter
+	{
+		void operator()(void* _p) const { ::free(_p); }
+	};
+
+	// writes all buffers starting at _offset, in batches of IOV_MAX and continuing after partial writes
+	bool writeVectored(const int _fd, std::vector<iovec>& _iov, off_t _offset)
+	{
+		size_t first = 0;
+
+		while(first < _iov.size())
+		{
+			const auto count = std::min(_iov.size() - first, static_cast<size_t>(IOV_MAX));
+			const auto res = ::pwritev(_fd, &_iov[first], static_cast<int>(count), _offset);
+
+			if(res < 0 && errno == EINTR)
+				continue;
+
+			if(res <= 0)
+				return false;
+
+			_offset += res;
+
+			auto written = static_cast<size_t>(res);
+
+			for(; first < _iov.size() && written >= _iov[first].iov_len; ++first)
+				written -= _iov[first].iov_len;
+
+			if(written)
+			{
+				_iov[first].iov_base = static_cast<uint8_t*>(_iov[first].iov_base) + written;
+				_iov[first].iov_len -= written;
+			}
+		}
+
+		return true;
+	}
+
+	bool writeAligned(const int _fd, const uint8_t* _data, const size_t _size, off_t _offset)
+	{
+		std::vector<iovec> iov{{const_cast<uint8_t*>(_data), _size}};
+		return writeVectored(_fd, iov, _offset);
+	}
+
+	// O_DIRECT requires the memory address, size and file offset to be aligned. The buffers are copied into an aligned
+	// staging buffer, the padding of the last block is truncated afterwards
+	bool writeDirect(const int _fd, const std::vector<FileWriter::Buffer>& _buffers, const size_t _totalSize)
+	{
+		void* mem = nullptr;
+
+		if(::posix_memalign(&mem, g_directAlignment, g_directBufferSize) != 0)
+			return false;
+
+		const std::unique_ptr<uint8_t, FreeDeleter> staging(static_cast<uint8_t*>(mem));
+
+		size_t used = 0;
+		off_t offset = 0;
+
+		for(const auto& buffer : _buffers)
+		{
+			const auto* src = static_cast<const uint8_t*>(buffer.data);
+
+			for(size_t done = 0; done < buffer.size;)
+			{
+				const auto size = std::min(buffer.size - done, g_directBufferSize - used);
+
+				::memcpy(staging.get() + used, src + done, size);
+
+				used += size;
+				done += size;
+
+				if(used < g_directBufferSize)
+					continue;
+
+				if(!writeAligned(_fd, staging.get(), used, offset))
+					return false;
+
+				offset += static_cast<off_t>(used);
+				used = 0;
+			}
+		}
+
+		if(used)
+		{
+			const auto padded = (used + g_directAlignment - 1) & ~(g_directAlignment - 1);
+
+			::memset(staging.get() + used, 0, padded - used);
+
+			if(!writeAligned(_fd, staging.get(), padded, offset))
+				return false;
+		}
+
+		return ::ftruncate(_fd, static_cast<off_t>(_totalSize)) == 0;
+	}
+
+	bool writeLinux(const std::string& _filename, const std::vector<FileWriter::Buffer>& _buffers, const FileIO _io)
+	{
+		size_t totalSize = 0;
+
+		std::vector<iovec> iov;
+		iov.reserve(_buffers.size());
+
+		for(const auto& buffer : _buffers)
+		{
+			if(!buffer.size)
+				continue;
+
+			iov.push_back({const_cast<void*>(buffer.data), buffer.size});
+			totalSize += buffer.size;
+		}
+
+		constexpr auto flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+		auto direct = _io == FileIODirect;
+
+		auto fd = direct ? ::open(_filename.c_str(), flags | O_DIRECT, 0666) : -1;
+
+		if(direct && fd < 0 && errno == EINVAL)
+		{
+			// the file system does not support O_DIRECT, e.g. tmpfs
+			if(!g_directUnsupportedLogged.exchange(true))
+				LOG("O_DIRECT is not supported for " << _filename << ", using buffered I/O");
+
+			direct = false;
+		}
+
+		if(!direct)
+			fd = ::open(_filename.c_str(), flags, 0666);
+
+		if(fd < 0)
+			return false;
+
+		// reserves contiguous space in one go instead of growing the file with every write. Not every file system supports it
+		if(totalSize)
+			::fallocate(fd, 0, 0, static_cast<off_t>(totalSize));
+
+		const auto res = (direct ? writeDirect(fd, _buffers, totalSize) : writeVectored(fd, iov, 0)) && ::fsync(fd) == 0;
+
+		return ::close(fd) == 0 && res;
+	}
+#endif
+
+#ifdef ASLIB_HAVE_IO_URING
+	constexpr unsigned g_uringEntries = 64;		// files in flight, every file has at most one operation pending
+	constexpr size_t g_uringFinishThreads = 4;	// rename, directory sync and completion callbacks block, they run on these
+
+	int uringSetup(const unsigned _entries, io_uring_params* _params)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_setup, _entries, _params));
+	}
+
+	int uringEnter(const int _fd, const unsigned _toSubmit, const unsigned _minComplete, const unsigned _flags)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_enter, _fd, _toSubmit, _minComplete, _flags, nullptr, 0));
+	}
+
+	int uringRegister(const int _fd, const unsigned _opcode, void* _arg, const unsigned _argCount)
+	{
+		return static_cast<int>(::syscall(__NR_io_uring_register, _fd, _opcode, _arg, _argCount));
+	}
+
+	// io_uring without liburing. Every file is created, preallocated, written, synced and closed by the kernel, a single thread
+	// processes the completions and queues the next step of the file. Writer threads only build the file contents.
+	// Closed files are renamed and reported by a small pool of its own so that the completion thread never blocks. It
+	// cannot use the writer pool: its threads might all wait in write() for a file in flight to finish
+	class UringQueue
+	{
+	public:
+		// nullptr if the kernel does not support io_uring or one of the required operations (Linux 5.6+)
+		static UringQueue* get()
+		{
+			static UringQueue queue;
+			return queue.m_ringFd >= 0 ? &queue : nullptr;
+		}
+
+		~UringQueue()
+		{
+			if(m_ringFd < 0)
+				return;
+
+			wait();
+
+			m_finishPool.reset();
+
+			{
+				// a request without user data stops the completion thread
+				std::lock_guard<std::mutex> lock(m_mutex);
+				auto& sqe = nextSqe();
+				sqe.opcode = IORING_OP_NOP;
+				commitSqe();
+			}
+
+			m_completionThread.join();
+
+			::munmap(m_sqes, g_uringEntries * sizeof(io_uring_sqe));
+			::munmap(m_ring, m_ringSize);
+			::close(m_ringFd);
+		}
+
+		void write(const std::string& _filename, const std::vector<FileWriter::Buffer>& _buffers, FileWriter::Completion _onComplete)
+		{
+			std::unique_ptr<Request> request(new Request());
+
+			request->filename = _filename;
+			request->tempFilename = FileWriter::getTempFilename(_filename);
+			request->onComplete = std::move(_onComplete);
+			request->iov.reserve(_buffers.size());
+
+			for(const auto& buffer : _buffers)
+			{
+				if(!buffer.size)
+					continue;
+
+				request->iov.push_back({const_cast<void*>(buffer.data), buffer.size});
+				request->size += buffer.size;
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_cvSpaceAvailable.wait(lock, [this] { return m_inFlight < g_uringEntries; });
+
+			++m_inFlight;
+			submit(*request.release());
+		}
+
+		size_t wait()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_cvIdle.wait(lock, [this] { return m_inFlight == 0; });
+
+			const auto failedCount = m_failedCount;
+			m_failedCount = 0;
+			return failedCount;
+		}
+
+	private:
+		enum Step
+		{
+			StepOpen,
+			StepAllocate,
+			StepWrite,
+			StepSync,
+			StepClose
+		};
+
+		struct Request
+		{
+			std::string filename;
+			std::string tempFilename;
+			std::vector<iovec> iov;
+			size_t iovFirst = 0;
+			uint64_t offset = 0;
+			uint64_t size = 0;
+			int fd = -1;
+			Step step = StepOpen;
+			bool success = true;
+			FileWriter::Completion onComplete;
+		};
+
+		UringQueue()
+		{
+			io_uring_params params{};
+
+			m_ringFd = uringSetup(g_uringEntries, &params);
+
+			if(m_ringFd < 0)
+				return;
+
+			if(!isSupported(params) || !map(params))
+			{
+				if(m_ring != MAP_FAILED)
+					::munmap(m_ring, m_ringSize);
+
+				::close(m_ringFd);
+				m_ringFd = -1;
+				return;
+			}
+
+			// at most one job per file in flight, pushing never blocks
+			m_finishPool.reset(new asBase::ThreadPool(g_uringFinishThreads, g_uringEntries));
+
+			m_completionThread = std::thread(&UringQueue::completionThreadFunc, this);
+		}
+
+		bool isSupported(const io_uring_params& _params) const
+		{
+			if(!(_params.features & IORING_FEAT_SINGLE_MMAP) || _params.sq_entries < g_uringEntries)
+				return false;
+
+			std::vector<uint8_t> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+			auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+			if(uringRegister(m_ringFd, IORING_REGISTER_PROBE, probe, 256) < 0)
+				return false;
+
+			for(const auto op : {IORING_OP_OPENAT, IORING_OP_FALLOCATE, IORING_OP_WRITEV, IORING_OP_FSYNC, IORING_OP_CLOSE, IORING_OP_NOP})
+			{
+				if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+					return false;
+			}
+
+			return true;
+		}
+
+		bool map(const io_uring_params& _params)
+		{
+			// submission and completion queue share one mapping
+			m_ringSize = std::max(_params.sq_off.array + _params.sq_entries * sizeof(unsigned), _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe));
+			m_ring = ::mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+
+			if(m_ring == MAP_FAILED)
+				return false;
+
+			void* sqes = ::mmap(nullptr, g_uringEntries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+
+			if(sqes == MAP_FAILED)
+				return false;
+
+			auto* ring = static_cast<uint8_t*>(m_ring);
+
+			m_sqes = static_cast<io_uring_sqe*>(sqes);
+			m_sqTail = reinterpret_cast<unsigned*>(ring + _params.sq_off.tail);
+			m_sqMask = *reinterpret_cast<unsigned*>(ring + _params.sq_off.ring_mask);
+			m_sqArray = reinterpret_cast<unsigned*>(ring + _params.sq_off.array);
+			m_cqHead = reinterpret_cast<unsigned*>(ring + _params.cq_off.head);
+			m_cqTail = reinterpret_cast<unsigned*>(ring + _params.cq_off.tail);
+			m_cqMask = *reinterpret_cast<unsigned*>(ring + _params.cq_off.ring_mask);
+			m_cqes = reinterpret_cast<io_uring_cqe*>(ring + _params.cq_off.cqes);
+
+			return true;
+		}
+
+		// the submission queue cannot overflow as there are never more operations pending than entries. m_mutex must be locked
+		io_uring_sqe& nextSqe()
+		{
+			auto& sqe = m_sqes[*m_sqTail & m_sqMask];
+			::memset(&sqe, 0, sizeof(sqe));
+			return sqe;
+		}
+
+		void commitSqe()
+		{
+			const auto tail = *m_sqTail;
+
+			m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+			__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+			while(uringEnter(m_ringFd, 1, 0, 0) < 0 && (errno == EINTR || errno == EAGAIN))
+				std::this_thread::yield();
+		}
+
+		// queues the current step of the request. m_mutex must be locked
+		void submit(Request& _request)
+		{
+			auto& sqe = nextSqe();
+
+			sqe.user_data = reinterpret_cast<uint64_t>(&_request);
+
+			switch(_request.step)
+			{
+			case StepOpen:
+				sqe.opcode = IORING_OP_OPENAT;
+				sqe.fd = AT_FDCWD;
+				sqe.addr = reinterpret_cast<uint64_t>(_request.tempFilename.c_str());
+				sqe.len = 0666;
+				sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+				break;
+			case StepAllocate:
+				sqe.opcode = IORING_OP_FALLOCATE;
+				sqe.fd = _request.fd;
+				sqe.addr = _request.size;
+				break;
+			case StepWrite:
+				sqe.opcode = IORING_OP_WRITEV;
+				sqe.fd = _request.fd;
+				sqe.addr = reinterpret_cast<uint64_t>(&_request.iov[_request.iovFirst]);
+				sqe.len = static_cast<uint32_t>(std::min(_request.iov.size() - _request.iovFirst, static_cast<size_t>(IOV_MAX)));
+				sqe.off = _request.offset;
+				break;
+			case StepSync:
+				sqe.opcode = IORING_OP_FSYNC;
+				sqe.fd = _request.fd;
+				break;
+			case StepClose:
+				sqe.opcode = IORING_OP_CLOSE;
+				sqe.fd = _request.fd;
+				break;
+			}
+
+			commitSqe();
+		}
+
+		// continues with the next step once the current one has completed with _result
+		void advance(Request& _request, const int _result)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			switch(_request.step)
+			{
+			case StepOpen:
+				if(_result < 0)
+				{
+					_request.success = false;
+					break;
+				}
+				_request.fd = _result;
+				_request.step = _request.size ? StepAllocate : StepSync;
+				submit(_request);
+				return;
+			case StepAllocate:
+				// not every file system supports it, the result is ignored
+				_request.step = StepWrite;
+				submit(_request);
+				return;
+			case StepWrite:
+				if(_result == -EINTR || _result == -EAGAIN)
+				{
+					submit(_request);
+					return;
+				}
+				if(_result <= 0)
+				{
+					_request.success = false;
+					_request.step = StepClose;
+					submit(_request);
+					return;
+				}
+
+				_request.offset += static_cast<uint64_t>(_result);
+
+				for(auto written = static_cast<size_t>(_result); written;)
+				{
+					auto& iov = _request.iov[_request.iovFirst];
+
+					if(written < iov.iov_len)
+					{
+						iov.iov_base = static_cast<uint8_t*>(iov.iov_base) + written;
+						iov.iov_len -= written;
+						break;
+					}
+
+					written -= iov.iov_len;
+					++_request.iovFirst;
+				}
+
+				if(_request.offset >= _request.size)
+					_request.step = StepSync;
+				submit(_request);
+				return;
+			case StepSync:
+				if(_result < 0)
+					_request.success = false;
+				_request.step = StepClose;
+				submit(_request);
+				return;
+			case StepClose:
+				if(_result < 0)
+					_request.success = false;
+				break;
+			}
+
+			// the file is closed
+			lock.unlock();
+
+			auto* request = &_request;
+
+			m_finishPool->push([this, request]
+			{
+				finish(*request);
+			});
+		}
+
+		// moves the closed file into place and reports the result, runs on the finish pool
+		void finish(Request& _request)
+		{
+			const std::unique_ptr<Request> request(&_request);
+
+			if(request->success)
+				request->success = FileWriter::replaceFile(request->tempFilename, request->filename);
+			else
+				::remove(request->tempFilename.c_str());
+
+			if(!request->success)
+				LOG_ERROR("Failed to write file " << request->filename);
+
+			request->onComplete(request->success);
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if(!request->success)
+				++m_failedCount;
+
+			--m_inFlight;
+
+			m_cvSpaceAvailable.notify_one();
+
+			if(!m_inFlight)
+				m_cvIdle.notify_all();
+		}
+
+		void completionThreadFunc()
+		{
+			while(true)
+			{
+				if(uringEnter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+				{
+					LOG_ERROR("io_uring_enter failed with error " << errno);
+					std::this_thread::yield();
+				}
+
+				// only this thread consumes completions
+				auto head = *m_cqHead;
+				const auto tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+				for(; head != tail; ++head)
+				{
+					const auto& cqe = m_cqes[head & m_cqMask];
+
+					auto* request = reinterpret_cast<Request*>(cqe.user_data);
+					const auto result = cqe.res;
+
+					__atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+
+					if(!request)
+						return;
+
+					advance(*request, result);
+				}
+			}
+		}
+
+		int m_ringFd = -1;
+
+		void* m_ring = MAP_FAILED;
+		size_t m_ringSize = 0;
+
+		io_uring_sqe* m_sqes = nullptr;
+		unsigned* m_sqTail = nullptr;
+		unsigned m_sqMask = 0;
+		unsigned* m_sqArray = nullptr;
+
+		unsigned* m_cqHead = nullptr;
+		unsigned* m_cqTail = nullptr;
+		unsigned m_cqMask = 0;
+		io_uring_cqe* m_cqes = nullptr;
+
+		std::mutex m_mutex;
+		std::condition_variable m_cvSpaceAvailable;
+		std::condition_variable m_cvIdle;
+		size_t m_inFlight = 0;
+		size_t m_failedCount = 0;
+
+		std::thread m_completionThread;
+
+		std::unique_ptr<asBase::ThreadPool> m_finishPool;
+	};
+#endif
+}
+
+bool FileWriter::write(const std::string& _filename, const std::vector<Buffer>& _buffers, const FileIO _io)
+{
+	const auto tempFilename = getTempFilename(_filename);
+
+#ifdef __linux__
+	const auto res = _io != FileIOStdio
+		? writeLinux(tempFilename, _buffers, _io == FileIOUring ? FileIOVectored : _io)
+		: writeStdio(tempFilename, _buffers);
+#else
+	const auto res = writeStdio(tempFilename, _buffers);
+#endif
+
+	if(!res)
+	{
+		::remove(tempFilename.c_str());
+		return false;
+	}
+
+	return replaceFile(tempFilename, _filename);
+}
+
+bool FileWriter::isAsync(const FileIO _io)
+{
+#ifdef ASLIB_HAVE_IO_URING
+	if(_io != FileIOUring)
+		return false;
+
+	if(UringQueue::get())
+		return true;
+
+	static std::atomic<bool> logged{false};
+
+	if(!logged.exchange(true))
+		LOG("io_uring is not available, files are written by the writer threads");
+#else
+	(void)_io;
+#endif
+	return false;
+}
+
+void FileWriter::writeAsync(const std::string& _filename, const std::vector<Buffer>& _buffers, Completion _onComplete)
+{
+#ifdef ASLIB_HAVE_IO_URING
+	if(auto* queue = UringQueue::get())
+	{
+		queue->write(_filename, _buffers, std::move(_onComplete));
+		return;
+	}
+#endif
+	_onComplete(write(_filename, _buffers, FileIOVectored));
+}
+
+std::string FileWriter::getTempFilename(const std::string& _filename)
+{
+	return _filename + ".tmp";
+}
+
+bool FileWriter::replaceFile(const std::string& _tempFilename, const std::string& _filename)
+{
+#ifdef _WIN32
+	// rename does not replace existing files on Windows
+	::remove(_filename.c_str());
+#endif
+	if(::rename(_tempFilename.c_str(), _filename.c_str()) == 0)
+	{
+		syncDirectory(_filename);
+		return true;
+	}
+
+	::remove(_tempFilename.c_str());
+	return false;
+}
+
+bool FileWriter::syncFile(FILE* _handle)
+{
+	if(fflush(_handle) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(_handle)) == 0;
+#else
+	return ::fsync(fileno(_handle)) == 0;
+#endif
+}
+
+size_t FileWriter::waitAsync()
+{
+#ifdef ASLIB_HAVE_IO_URING
+	if(auto* queue = UringQueue::get())
+		return queue->wait();
+#endif
+	return 0;
+}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "config.h"
+
+namespace asLib
+{
+	// Writes files whose content is completely in memory, split into multiple buffers, e.g. header, audio data and trailing chunks
+	class FileWriter
+	{
+	public:
+		struct Buffer
+		{
+			const void* data;
+			size_t size;
+		};
+
+		using Completion = std::function<void(bool _success)>;
+
+		// creates or replaces _filename with the concatenation of all buffers. Returns false if the file cannot be written.
+		// All writes go to a temporary file that replaces _filename once it is complete and synced to disk, neither a crash nor a
+		// power loss leaves a partial file
+		static bool write(const std::string& _filename, const std::vector<Buffer>& _buffers, FileIO _io);
+
+		// true if writes with _io are asynchronous, which requires FileIOUring and a kernel that supports it
+		static bool isAsync(FileIO _io);
+
+		// queues the write and returns immediately, blocks only if too many files are in flight. _onComplete is called from
+		// a completion thread once the file has been closed, the buffers need to stay valid until then. Requires isAsync()
+		static void writeAsync(const std::string& _filename, const std::vector<Buffer>& _buffers, Completion _onComplete);
+
+		// blocks until all asynchronous writes have completed. Returns the number of files that failed since the last call
+		static size_t waitAsync();
+
+		// name of the file that is written before it replaces _filename
+		static std::string getTempFilename(const std::string& _filename);
+
+		// renames _tempFilename to _filename, replacing an existing file, and syncs the directory. Removes _tempFilename if
+		// that fails. _tempFilename has to be synced already, see syncFile()
+		static bool replaceFile(const std::string& _tempFilename, const std::string& _filename);
+
+		// flushes _handle and waits until its data is on disk
+		static bool syncFile(FILE* _handle);
+	};
+}
@@ -0,0 +1,212 @@
+#include "filenameTemplate.h"
+
+namespace asLib
+{
+constexpr size_t g_maxDigits = 9;
+
+namespace
+{
+	const char* const g_keys[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+	void appendNumber(std::string& _result, int _value, const size_t _minDigits)
+	{
+		if(_value < 0)
+		{
+			_result.push_back('-');
+			_value = -_value;
+		}
+
+		char digits[12];
+		size_t count = 0;
+
+		do
+		{
+			digits[count++] = static_cast<char>('0' + _value % 10);
+			_value /= 10;
+		}
+		while(_value);
+
+		for(auto i=count; i<_minDigits; ++i)
+			_result.push_back('0');
+
+		while(count)
+			_result.push_back(digits[--count]);
+	}
+
+	void appendKeyName(std::string& _result, const int _note)
+	{
+		const auto octave = _note / 12;
+
+		_result += g_keys[_note - octave * 12];
+		appendNumber(_result, octave - 2, 1);	// C-2 to G8
+	}
+
+	// parses a decimal number of up to g_maxDigits digits
+	bool parseNumber(const std::string& _text, size_t& _result)
+	{
+		if(_text.empty() || _text.size() > g_maxDigits)
+			return false;
+
+		_result = 0;
+
+		for(const auto c : _text)
+		{
+			if(c < '0' || c > '9')
+				return false;
+			_result = _result * 10 + static_cast<size_t>(c - '0');
+		}
+		return true;
+	}
+
+	std::vector<std::string> split(const std::string& _text, const char _delimiter)
+	{
+		std::vector<std::string> result;
+
+		size_t start = 0;
+
+		for(auto pos = _text.find(_delimiter); pos != std::string::npos; pos = _text.find(_delimiter, start))
+		{
+			result.push_back(_text.substr(start, pos - start));
+			start = pos + 1;
+		}
+
+		result.push_back(_text.substr(start));
+		return result;
+	}
+}
+
+FilenameTemplate::FilenameTemplate(const std::string& _template)
+{
+	static const struct
+	{
+		const char* name;
+		Placeholder type;
+		size_t digits;
+	} placeholders[] =
+	{
+		{"program", PlaceholderProgram, 3},
+		{"note", PlaceholderNote, 3},
+		{"velocity", PlaceholderVelocity, 3},
+		{"channel", PlaceholderChannel, 2},
+		{"key", PlaceholderKey, 0},
+		{"round", PlaceholderRound, 2},
+		{"layer", PlaceholderLayer, 2},
+		{"cc", PlaceholderController, 3},
+		{"device", PlaceholderDevice, 2},
+	};
+
+	// parses the content between the braces, returns false if it is not a known placeholder
+	auto parsePlaceholder = [&](const std::string& _content, Segment& _segment)
+	{
+		const auto args = split(_content, ':');
+
+		for(const auto& placeholder : placeholders)
+		{
+			if(args.front() != placeholder.name)
+				continue;
+
+			_segment.type = placeholder.type;
+			_segment.digits = placeholder.digits;
+			_segment.controller = 0;
+
+			size_t arg = 1;
+
+			if(placeholder.type == PlaceholderController)
+			{
+				size_t controller;
+				if(args.size() < 2 || !parseNumber(args[1], controller) || controller > 127)
+					return false;
+				_segment.controller = static_cast<uint8_t>(controller);
+				++arg;
+			}
+
+			if(args.size() == arg)
+				return true;
+
+			// optional digit count, the key name is not a number
+			return args.size() == arg + 1 && placeholder.type != PlaceholderKey && parseNumber(args[arg], _segment.digits) && _segment.digits <= g_maxDigits;
+		}
+		return false;
+	};
+
+	std::string text;
+
+	for(size_t pos = 0; pos < _template.size();)
+	{
+		if(_template[pos] == '{')
+		{
+			const auto end = _template.find('}', pos);
+
+			Segment segment;
+
+			if(end != std::string::npos && parsePlaceholder(_template.substr(pos + 1, end - pos - 1), segment))
+			{
+				if(!text.empty())
+					m_segments.push_back({PlaceholderText, 0, 0, std::move(text)});
+
+				text.clear();
+
+				m_length += segment.type == PlaceholderKey ? 3 : segment.digits;
+				m_segments.push_back(std::move(segment));
+
+				pos = end + 1;
+				continue;
+			}
+		}
+
+		text.push_back(_template[pos]);
+		++m_length;
+		++pos;
+	}
+
+	if(!text.empty())
+		m_segments.push_back({PlaceholderText, 0, 0, std::move(text)});
+}
+
+void FilenameTemplate::render(std::string& _result, const Values& _values) const
+{
+	_result.clear();
+
+	for(const auto& segment : m_segments)
+	{
+		switch(segment.type)
+		{
+		case PlaceholderText:		_result += segment.text;													break;
+		case PlaceholderProgram:	appendNumber(_result, _values.program, segment.digits);						break;
+		case PlaceholderNote:		appendNumber(_result, _values.note, segment.digits);						break;
+		case PlaceholderVelocity:	appendNumber(_result, _values.velocity, segment.digits);					break;
+		case PlaceholderChannel:	appendNumber(_result, _values.channel, segment.digits);						break;
+		case PlaceholderKey:		appendKeyName(_result, _values.note);										break;
+		case PlaceholderRound:		appendNumber(_result, _values.round, segment.digits);						break;
+		case PlaceholderLayer:		appendNumber(_result, _values.layer, segment.digits);						break;
+		case PlaceholderController:	appendNumber(_result, _values.controllers ? _values.controllers[segment.controller] : 0, segment.digits);	break;
+		case PlaceholderDevice:		appendNumber(_result, _values.device, segment.digits);						break;
+		}
+	}
+}
+
+std::string FilenameTemplate::render(const Values& _values) const
+{
+	std::string result;
+	result.reserve(m_length);
+	render(result, _values);
+	return result;
+}
+
+bool FilenameTemplate::hasPlaceholder(const Placeholder _placeholder) const
+{
+	for(const auto& segment : m_segments)
+	{
+		if(segment.type == _placeholder)
+			return true;
+	}
+	return false;
+}
+
+std::string FilenameTemplate::getKeyName(const int _note)
+{
+	std::string result;
+	appendKeyName(result, _note);
+	return result;
+}
+}
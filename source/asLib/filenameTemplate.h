@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace asLib
+{
+	// Filename with placeholders such as {note} or {velocity}. It is parsed once into a list of literals and placeholders
+	// and then rendered for every voice without searching the string again.
+	// Numbers are zero padded, the number of digits can be specified per placeholder, for example {note:2}. {cc:N} is the
+	// value of controller N, {cc:N:digits} with a digit count. Unknown placeholders are kept as they are
+	class FilenameTemplate
+	{
+	public:
+		enum Placeholder
+		{
+			PlaceholderText,
+			PlaceholderProgram,
+			PlaceholderNote,
+			PlaceholderVelocity,
+			PlaceholderChannel,
+			PlaceholderKey,
+			PlaceholderRound,
+			PlaceholderLayer,
+			PlaceholderController,
+			PlaceholderDevice,
+		};
+
+		struct Values
+		{
+			int program = 0;
+			int note = 0;
+			int velocity = 0;
+			int channel = 0;
+			int round = 0;
+			int layer = 0;
+			const uint8_t* controllers = nullptr;	// 128 controller values, rendered as 0 if not available
+			int device = 0;							// index of the device of a session
+		};
+
+		explicit FilenameTemplate(const std::string& _template = std::string());
+
+		// replaces the content of _result, its capacity is reused
+		void render(std::string& _result, const Values& _values) const;
+		std::string render(const Values& _values) const;
+
+		bool hasPlaceholder(Placeholder _placeholder) const;
+
+		// name of a note, C-2 to G8
+		static std::string getKeyName(int _note);
+
+	private:
+		struct Segment
+		{
+			Placeholder type;
+			size_t digits;
+			uint8_t controller;
+			std::string text;
+		};
+
+		std::vector<Segment> m_segments;
+		size_t m_length = 0;
+	};
+}
@@ -0,0 +1,879 @@
+#include "flacWriter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "error.h"
+#include "fileWriter.h"
+
+#include "../asBase/threadPool.h"
+
+namespace asLib
+{
+constexpr size_t g_flacBlockSize = 4096;
+constexpr size_t g_flacFramesPerJob = 16;			// frames that are encoded at once when running in parallel
+constexpr int g_flacMaxFixedOrder = 4;
+constexpr int g_flacMaxLpcOrder = 8;
+constexpr int g_flacLpcPrecision = 15;				// bits of the quantized LPC coefficients, the maximum of the streamable subset
+constexpr int g_flacMaxPartitionOrder = 8;
+constexpr int g_flacMaxRiceParameter = 14;			// 4 bit parameters, 15 is the escape code
+constexpr int g_flacMaxRice2Parameter = 30;			// 5 bit parameters, 31 is the escape code
+
+namespace
+{
+	enum ChannelAssignment
+	{
+		Independent = 0,		// + channel count - 1
+		LeftSide = 8,
+		SideRight = 9,
+		MidSide = 10,
+	};
+
+	enum SubframeType
+	{
+		SubframeConstant,
+		SubframeVerbatim,
+		SubframeFixed,
+		SubframeLpc,
+	};
+
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<uint8_t>& _buffer) : m_buffer(_buffer) {}
+
+		// up to 32 bits
+		void write(const uint64_t _value, const int _bits)
+		{
+			if(!_bits)
+				return;
+
+			m_accumulator = (m_accumulator << _bits) | (_value & ((uint64_t(1) << _bits) - 1));
+			m_bitCount += _bits;
+
+			while(m_bitCount >= 8)
+			{
+				m_bitCount -= 8;
+				m_buffer.push_back(static_cast<uint8_t>(m_accumulator >> m_bitCount));
+			}
+		}
+
+		void writeSigned(const int64_t _value, const int _bits)
+		{
+			write(static_cast<uint64_t>(_value), _bits);
+		}
+
+		void writeUnary(uint64_t _zeroes)
+		{
+			while(_zeroes >= 32)
+			{
+				write(0, 32);
+				_zeroes -= 32;
+			}
+			write(1, static_cast<int>(_zeroes) + 1);
+		}
+
+		void writeRice(const uint64_t _value, const int _parameter)
+		{
+			writeUnary(_value >> _parameter);
+			write(_value, _parameter);
+		}
+
+		void writeUtf8(const uint32_t _value)
+		{
+			if(_value < 0x80)
+			{
+				write(_value, 8);
+				return;
+			}
+
+			int extraBytes = 1;
+			while(extraBytes < 5 && _value >= (1u << (5 * extraBytes + 6)))
+				++extraBytes;
+
+			// leading byte: one bit per byte followed by a zero, then the most significant bits of the value
+			write((0xffu << (7 - extraBytes)) | (_value >> (6 * extraBytes)), 8);
+
+			for(auto i=extraBytes-1; i>=0; --i)
+				write(0x80 | ((_value >> (6 * i)) & 0x3f), 8);
+		}
+
+		void alignToByte()
+		{
+			if(m_bitCount)
+				write(0, 8 - m_bitCount);
+		}
+
+	private:
+		std::vector<uint8_t>& m_buffer;
+		uint64_t m_accumulator = 0;
+		int m_bitCount = 0;
+	};
+
+	struct RiceCoding
+	{
+		int partitionOrder = 0;
+		int parameterBits = 4;
+		int parameters[1 << g_flacMaxPartitionOrder];
+		uint64_t bits = 0;
+	};
+
+	struct Subframe
+	{
+		SubframeType type = SubframeVerbatim;
+		int order = 0;
+		int shift = 0;
+		int32_t coefficients[g_flacMaxLpcOrder];
+		RiceCoding rice;
+		uint64_t bits = 0;
+	};
+
+	// encodes frames, instances are not shared between threads as they keep scratch buffers
+	class FrameEncoder
+	{
+	public:
+		FrameEncoder(const uint8_t* _data, const SampleFormat _format, const size_t _channelCount, const int _bitsPerSample, const int _samplerate)
+		: m_data(_data), m_format(_format), m_channelCount(_channelCount), m_bitsPerSample(_bitsPerSample), m_samplerate(_samplerate)
+		, m_bytesPerSample(getSampleSize(_format))
+		{
+			m_channels.resize(std::max(_channelCount, static_cast<size_t>(4)));
+		}
+
+		void encode(std::vector<uint8_t>& _out, size_t _frameIndex, size_t _firstFrame, size_t _frameCount);
+
+	private:
+		int64_t readSample(const uint8_t* _src) const;
+		void writeHeader(BitWriter& _bw, std::vector<uint8_t>& _out, size_t _headerStart, size_t _frameIndex, size_t _frameCount, int _channelAssignment) const;
+		void encodeSubframe(BitWriter& _bw, std::vector<int64_t>& _samples, int _bitsPerSample);
+
+		void evaluateFixed(const int64_t* _samples, size_t _count, int _bitsPerSample, Subframe& _best);
+		void evaluateLpc(const int64_t* _samples, size_t _count, int _bitsPerSample, Subframe& _best);
+		bool computeRice(const int64_t* _residual, size_t _count, int _order, RiceCoding& _coding);
+		void writeResidual(BitWriter& _bw, const int64_t* _residual, size_t _count, int _order, const RiceCoding& _coding) const;
+
+		const uint8_t* const m_data;
+		const SampleFormat m_format;
+		const size_t m_channelCount;
+		const int m_bitsPerSample;
+		const int m_samplerate;
+		const size_t m_bytesPerSample;
+
+		std::vector<std::vector<int64_t>> m_channels;
+		std::vector<int64_t> m_residual;
+		std::vector<int64_t> m_bestResidual;
+		std::vector<uint64_t> m_partitionSums;
+		std::vector<double> m_window;
+		std::vector<double> m_windowed;
+	};
+
+	uint8_t crc8(const uint8_t* _data, const size_t _size)
+	{
+		uint8_t crc = 0;
+		for(size_t i=0; i<_size; ++i)
+		{
+			crc ^= _data[i];
+			for(int b=0; b<8; ++b)
+				crc = static_cast<uint8_t>(crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+		}
+		return crc;
+	}
+
+	uint16_t crc16(const uint8_t* _data, const size_t _size)
+	{
+		static uint16_t table[256];
+		static const bool tableValid = []
+		{
+			for(uint32_t i=0; i<256; ++i)
+			{
+				uint32_t crc = i << 8;
+				for(int b=0; b<8; ++b)
+					crc = crc & 0x8000 ? (crc << 1) ^ 0x8005 : crc << 1;
+				table[i] = static_cast<uint16_t>(crc);
+			}
+			return true;
+		}();
+		(void)tableValid;
+
+		uint16_t crc = 0;
+		for(size_t i=0; i<_size; ++i)
+			crc = static_cast<uint16_t>((crc << 8) ^ table[(crc >> 8) ^ _data[i]]);
+		return crc;
+	}
+
+	uint64_t zigzag(const int64_t _value)
+	{
+		return (static_cast<uint64_t>(_value) << 1) ^ static_cast<uint64_t>(_value >> 63);
+	}
+
+	bool fitsInt32(const int64_t* _values, const size_t _count)
+	{
+		for(size_t i=0; i<_count; ++i)
+		{
+			if(_values[i] < std::numeric_limits<int32_t>::min() || _values[i] > std::numeric_limits<int32_t>::max())
+				return false;
+		}
+		return true;
+	}
+
+	void computeFixedResidual(const int64_t* _s, const size_t _count, const int _order, int64_t* _residual)
+	{
+		for(size_t i=_order; i<_count; ++i)
+		{
+			switch (_order)
+			{
+			case 0:	_residual[i] = _s[i]; break;
+			case 1:	_residual[i] = _s[i] - _s[i-1]; break;
+			case 2:	_residual[i] = _s[i] - 2 * _s[i-1] + _s[i-2]; break;
+			case 3:	_residual[i] = _s[i] - 3 * _s[i-1] + 3 * _s[i-2] - _s[i-3]; break;
+			default:_residual[i] = _s[i] - 4 * _s[i-1] + 6 * _s[i-2] - 4 * _s[i-3] + _s[i-4]; break;
+			}
+		}
+	}
+
+	uint64_t sumOfAbsoluteFixedResidual(const int64_t* _s, const size_t _count, const int _order)
+	{
+		uint64_t sum = 0;
+		int64_t r;
+		for(size_t i=_order; i<_count; ++i)
+		{
+			switch (_order)
+			{
+			case 0:	r = _s[i]; break;
+			case 1:	r = _s[i] - _s[i-1]; break;
+			case 2:	r = _s[i] - 2 * _s[i-1] + _s[i-2]; break;
+			case 3:	r = _s[i] - 3 * _s[i-1] + 3 * _s[i-2] - _s[i-3]; break;
+			default:r = _s[i] - 4 * _s[i-1] + 6 * _s[i-2] - 4 * _s[i-3] + _s[i-4]; break;
+			}
+			sum += static_cast<uint64_t>(r < 0 ? -r : r);
+		}
+		return sum;
+	}
+
+	int64_t FrameEncoder::readSample(const uint8_t* _src) const
+	{
+		switch (m_format)
+		{
+		case SampleFormatInt8:	return static_cast<int8_t>(_src[0]);
+		case SampleFormatUInt8:	return static_cast<int64_t>(_src[0]) - 128;
+		case SampleFormatInt16:	{ int16_t v; ::memcpy(&v, _src, sizeof(v)); return v; }
+		case SampleFormatInt24:	return static_cast<int32_t>((static_cast<uint32_t>(_src[0]) << 8) | (static_cast<uint32_t>(_src[1]) << 16) | (static_cast<uint32_t>(_src[2]) << 24)) >> 8;
+		case SampleFormatInt32:	{ int32_t v; ::memcpy(&v, _src, sizeof(v)); return v; }
+		default:				return 0;
+		}
+	}
+
+	void FrameEncoder::encode(std::vector<uint8_t>& _out, const size_t _frameIndex, const size_t _firstFrame, const size_t _frameCount)
+	{
+		_out.clear();
+
+		// deinterleave
+		const auto bytesPerFrame = m_bytesPerSample * m_channelCount;
+
+		for(size_t c=0; c<m_channelCount; ++c)
+		{
+			auto& channel = m_channels[c];
+			channel.resize(_frameCount);
+
+			const auto* src = m_data + _firstFrame * bytesPerFrame + c * m_bytesPerSample;
+
+			for(size_t i=0; i<_frameCount; ++i, src += bytesPerFrame)
+				channel[i] = readSample(src);
+		}
+
+		// stereo decorrelation, the side channel needs one more bit which we do not have for 32 bit samples
+		auto channelAssignment = static_cast<int>(Independent + m_channelCount - 1);
+
+		if(m_channelCount == 2 && m_bitsPerSample < 32)
+		{
+			auto& left = m_channels[0];
+			auto& right = m_channels[1];
+			auto& mid = m_channels[2];
+			auto& side = m_channels[3];
+
+			mid.resize(_frameCount);
+			side.resize(_frameCount);
+
+			for(size_t i=0; i<_frameCount; ++i)
+			{
+				mid[i] = (left[i] + right[i]) >> 1;
+				side[i] = left[i] - right[i];
+			}
+
+			// estimate the cost of each channel with a second order predictor, like the reference encoder does
+			const auto order = std::min(2, static_cast<int>(_frameCount) - 1);
+			const auto costLeft = sumOfAbsoluteFixedResidual(left.data(), _frameCount, order);
+			const auto costRight = sumOfAbsoluteFixedResidual(right.data(), _frameCount, order);
+			const auto costMid = sumOfAbsoluteFixedResidual(mid.data(), _frameCount, order);
+			const auto costSide = sumOfAbsoluteFixedResidual(side.data(), _frameCount, order);
+
+			const uint64_t costs[4] = {costLeft + costRight, costLeft + costSide, costSide + costRight, costMid + costSide};
+			const int assignments[4] = {Independent + 1, LeftSide, SideRight, MidSide};
+
+			const auto best = std::min_element(costs, costs + 4) - costs;
+			channelAssignment = assignments[best];
+
+			switch (channelAssignment)
+			{
+			case LeftSide:	std::swap(m_channels[1], m_channels[3]); break;	// left, side
+			case SideRight:	std::swap(m_channels[0], m_channels[3]); break;	// side, right
+			case MidSide:	std::swap(m_channels[0], m_channels[2]); std::swap(m_channels[1], m_channels[3]); break;	// mid, side
+			default:;
+			}
+		}
+
+		BitWriter bw(_out);
+
+		writeHeader(bw, _out, 0, _frameIndex, _frameCount, channelAssignment);
+
+		for(size_t c=0; c<m_channelCount; ++c)
+		{
+			const auto isSide = (channelAssignment == LeftSide && c == 1) || (channelAssignment == SideRight && c == 0) || (channelAssignment == MidSide && c == 1);
+			encodeSubframe(bw, m_channels[c], m_bitsPerSample + (isSide ? 1 : 0));
+		}
+
+		bw.alignToByte();
+
+		const auto crc = crc16(_out.data(), _out.size());
+		bw.write(crc, 16);
+	}
+
+	void FrameEncoder::writeHeader(BitWriter& _bw, std::vector<uint8_t>& _out, const size_t _headerStart, const size_t _frameIndex, const size_t _frameCount, const int _channelAssignment) const
+	{
+		_bw.write(0x3ffe, 14);		// sync code
+		_bw.write(0, 1);			// reserved
+		_bw.write(0, 1);			// fixed block size, the header contains the frame number
+
+		// block size
+		int blockSizeCode;
+		if(_frameCount == 4096)			blockSizeCode = 12;
+		else if(_frameCount <= 256)		blockSizeCode = 6;
+		else							blockSizeCode = 7;
+		_bw.write(blockSizeCode, 4);
+
+		// sample rate
+		int samplerateCode;
+		switch (m_samplerate)
+		{
+		case 88200:		samplerateCode = 1; break;
+		case 176400:	samplerateCode = 2; break;
+		case 192000:	samplerateCode = 3; break;
+		case 8000:		samplerateCode = 4; break;
+		case 16000:		samplerateCode = 5; break;
+		case 22050:		samplerateCode = 6; break;
+		case 24000:		samplerateCode = 7; break;
+		case 32000:		samplerateCode = 8; break;
+		case 44100:		samplerateCode = 9; break;
+		case 48000:		samplerateCode = 10; break;
+		case 96000:		samplerateCode = 11; break;
+		default:
+			if(m_samplerate % 1000 == 0 && m_samplerate / 1000 <= 255)	samplerateCode = 12;
+			else if(m_samplerate <= 65535)								samplerateCode = 13;
+			else if(m_samplerate % 10 == 0 && m_samplerate / 10 <= 65535)	samplerateCode = 14;
+			else														samplerateCode = 0;	// from STREAMINFO
+		}
+		_bw.write(samplerateCode, 4);
+
+		_bw.write(_channelAssignment, 4);
+
+		int sampleSizeCode;
+		switch (m_bitsPerSample)
+		{
+		case 8:		sampleSizeCode = 1; break;
+		case 16:	sampleSizeCode = 4; break;
+		case 24:	sampleSizeCode = 6; break;
+		default:	sampleSizeCode = 7; break;	// 32
+		}
+		_bw.write(sampleSizeCode, 3);
+		_bw.write(0, 1);			// reserved
+
+		_bw.writeUtf8(static_cast<uint32_t>(_frameIndex));
+
+		if(blockSizeCode == 6)
+			_bw.write(_frameCount - 1, 8);
+		else if(blockSizeCode == 7)
+			_bw.write(_frameCount - 1, 16);
+
+		if(samplerateCode == 12)
+			_bw.write(m_samplerate / 1000, 8);
+		else if(samplerateCode == 13)
+			_bw.write(m_samplerate, 16);
+		else if(samplerateCode == 14)
+			_bw.write(m_samplerate / 10, 16);
+
+		_bw.write(crc8(&_out[_headerStart], _out.size() - _headerStart), 8);
+	}
+
+	void FrameEncoder::encodeSubframe(BitWriter& _bw, std::vector<int64_t>& _samples, int _bitsPerSample)
+	{
+		const auto count = _samples.size();
+		auto* s = _samples.data();
+
+		// constant, usually silence
+		if(std::all_of(s + 1, s + count, [&](const int64_t _v) { return _v == s[0]; }))
+		{
+			_bw.write(0, 8);	// zero bit, constant, no wasted bits
+			_bw.writeSigned(s[0], _bitsPerSample);
+			return;
+		}
+
+		// lower bits that are zero in all samples, for example 16 bit material in a 24 bit stream
+		uint64_t bits = 0;
+		for(size_t i=0; i<count; ++i)
+			bits |= static_cast<uint64_t>(s[i]);
+
+		int wastedBits = 0;
+		while(!(bits & 1))
+		{
+			bits >>= 1;
+			++wastedBits;
+		}
+
+		if(wastedBits)
+		{
+			for(size_t i=0; i<count; ++i)
+				s[i] >>= wastedBits;
+			_bitsPerSample -= wastedBits;
+		}
+
+		Subframe best;
+		best.type = SubframeVerbatim;
+		best.bits = static_cast<uint64_t>(_bitsPerSample) * count;
+
+		m_residual.resize(count);
+		m_bestResidual.resize(count);
+
+		evaluateFixed(s, count, _bitsPerSample, best);
+		evaluateLpc(s, count, _bitsPerSample, best);
+
+		// subframe header
+		_bw.write(0, 1);
+
+		switch (best.type)
+		{
+		case SubframeFixed:	_bw.write(0x08 | best.order, 6); break;
+		case SubframeLpc:	_bw.write(0x20 | (best.order - 1), 6); break;
+		default:			_bw.write(0x01, 6); break;
+		}
+
+		if(wastedBits)
+		{
+			_bw.write(1, 1);
+			_bw.writeUnary(static_cast<uint64_t>(wastedBits - 1));
+		}
+		else
+		{
+			_bw.write(0, 1);
+		}
+
+		if(best.type == SubframeVerbatim)
+		{
+			for(size_t i=0; i<count; ++i)
+				_bw.writeSigned(s[i], _bitsPerSample);
+			return;
+		}
+
+		// warm-up samples
+		for(int i=0; i<best.order; ++i)
+			_bw.writeSigned(s[i], _bitsPerSample);
+
+		if(best.type == SubframeLpc)
+		{
+			_bw.write(g_flacLpcPrecision - 1, 4);
+			_bw.writeSigned(best.shift, 5);
+			for(int i=0; i<best.order; ++i)
+				_bw.writeSigned(best.coefficients[i], g_flacLpcPrecision);
+		}
+
+		writeResidual(_bw, m_bestResidual.data(), count, best.order, best.rice);
+	}
+
+	void FrameEncoder::evaluateFixed(const int64_t* _samples, const size_t _count, const int _bitsPerSample, Subframe& _best)
+	{
+		// pick the order with the smallest residual, then compute the exact size
+		const auto maxOrder = std::min(g_flacMaxFixedOrder, static_cast<int>(_count) - 1);
+
+		int order = 0;
+		uint64_t smallest = std::numeric_limits<uint64_t>::max();
+
+		for(int o=0; o<=maxOrder; ++o)
+		{
+			const auto sum = sumOfAbsoluteFixedResidual(_samples, _count, o);
+			if(sum < smallest)
+			{
+				smallest = sum;
+				order = o;
+			}
+		}
+
+		computeFixedResidual(_samples, _count, order, m_residual.data());
+
+		RiceCoding rice;
+		if(!computeRice(m_residual.data(), _count, order, rice))
+			return;
+
+		const auto bits = 8 + static_cast<uint64_t>(order) * _bitsPerSample + rice.bits;
+
+		if(bits >= _best.bits)
+			return;
+
+		_best.type = SubframeFixed;
+		_best.order = order;
+		_best.rice = rice;
+		_best.bits = bits;
+		std::swap(m_residual, m_bestResidual);
+	}
+
+	void FrameEncoder::evaluateLpc(const int64_t* _samples, const size_t _count, const int _bitsPerSample, Subframe& _best)
+	{
+		const auto maxOrder = std::min(g_flacMaxLpcOrder, static_cast<int>(_count) - 1);
+
+		if(maxOrder < 1)
+			return;
+
+		// tukey(0.5) window
+		if(m_window.size() != _count)
+		{
+			m_window.resize(_count);
+
+			const auto taper = static_cast<double>(_count) * 0.25;
+			for(size_t i=0; i<_count; ++i)
+			{
+				const auto pos = std::min(static_cast<double>(i), static_cast<double>(_count - 1 - i));
+				m_window[i] = pos < taper ? 0.5 * (1.0 - std::cos(3.14159265358979323846 * pos / taper)) : 1.0;
+			}
+		}
+
+		m_windowed.resize(_count);
+		for(size_t i=0; i<_count; ++i)
+			m_windowed[i] = static_cast<double>(_samples[i]) * m_window[i];
+
+		double autocorrelation[g_flacMaxLpcOrder + 1];
+		for(int lag=0; lag<=maxOrder; ++lag)
+		{
+			double sum = 0.0;
+			for(size_t i=lag; i<_count; ++i)
+				sum += m_windowed[i] * m_windowed[i - lag];
+			autocorrelation[lag] = sum;
+		}
+
+		if(autocorrelation[0] <= 0.0)
+			return;
+
+		// Levinson-Durbin, predicts s[i] = sum(lpc[j] * s[i-1-j])
+		double lpc[g_flacMaxLpcOrder][g_flacMaxLpcOrder];
+		double error[g_flacMaxLpcOrder];
+		double a[g_flacMaxLpcOrder] = {};
+		double err = autocorrelation[0];
+		int orderCount = 0;
+
+		for(int m=0; m<maxOrder; ++m)
+		{
+			auto acc = autocorrelation[m + 1];
+			for(int j=0; j<m; ++j)
+				acc -= a[j] * autocorrelation[m - j];
+
+			const auto k = acc / err;
+
+			double updated[g_flacMaxLpcOrder];
+			for(int j=0; j<m; ++j)
+				updated[j] = a[j] - k * a[m - 1 - j];
+			for(int j=0; j<m; ++j)
+				a[j] = updated[j];
+			a[m] = k;
+
+			err *= 1.0 - k * k;
+
+			std::copy(a, a + m + 1, lpc[m]);
+			error[m] = err;
+			++orderCount;
+
+			if(err <= 0.0)
+				break;
+		}
+
+		// choose the order with the smallest expected size
+		int order = 1;
+		double smallest = std::numeric_limits<double>::max();
+
+		for(int m=0; m<orderCount; ++m)
+		{
+			const auto o = m + 1;
+			const auto bitsPerResidual = error[m] > 0.0 ? std::max(0.0, 0.5 * std::log2(error[m] * 0.5 / static_cast<double>(_count))) : 0.0;
+			const auto bits = bitsPerResidual * static_cast<double>(_count - o) + o * (_bitsPerSample + g_flacLpcPrecision);
+
+			if(bits < smallest)
+			{
+				smallest = bits;
+				order = o;
+			}
+		}
+
+		// quantize
+		const auto* coefficients = lpc[order - 1];
+
+		double maxCoefficient = 0.0;
+		for(int i=0; i<order; ++i)
+			maxCoefficient = std::max(maxCoefficient, std::fabs(coefficients[i]));
+
+		if(maxCoefficient <= 0.0)
+			return;
+
+		int exponent;
+		std::frexp(maxCoefficient, &exponent);
+
+		const auto shift = std::min(15, g_flacLpcPrecision - 1 - exponent);
+
+		if(shift < 0)
+			return;
+
+		Subframe candidate;
+		candidate.type = SubframeLpc;
+		candidate.order = order;
+		candidate.shift = shift;
+
+		const auto qmax = (1 << (g_flacLpcPrecision - 1)) - 1;
+		const auto qmin = -(1 << (g_flacLpcPrecision - 1));
+
+		double quantizationError = 0.0;
+		for(int i=0; i<order; ++i)
+		{
+			const auto value = coefficients[i] * static_cast<double>(1 << shift) + quantizationError;
+			const auto q = std::max(qmin, std::min(qmax, static_cast<int>(std::lround(value))));
+			quantizationError = value - q;
+			candidate.coefficients[i] = q;
+		}
+
+		for(size_t i=order; i<_count; ++i)
+		{
+			int64_t prediction = 0;
+			for(int j=0; j<order; ++j)
+				prediction += static_cast<int64_t>(candidate.coefficients[j]) * _samples[i - 1 - j];
+			m_residual[i] = _samples[i] - (prediction >> shift);
+		}
+
+		if(!computeRice(m_residual.data(), _count, order, candidate.rice))
+			return;
+
+		candidate.bits = 8 + static_cast<uint64_t>(order) * _bitsPerSample + 4 + 5 + static_cast<uint64_t>(order) * g_flacLpcPrecision + candidate.rice.bits;
+
+		if(candidate.bits >= _best.bits)
+			return;
+
+		_best = candidate;
+		std::swap(m_residual, m_bestResidual);
+	}
+
+	bool FrameEncoder::computeRice(const int64_t* _residual, const size_t _count, const int _order, RiceCoding& _coding)
+	{
+		// decoders store residuals as 32 bit integers
+		if(!fitsInt32(_residual + _order, _count - _order))
+			return false;
+
+		int maxPartitionOrder = 0;
+		while(maxPartitionOrder < g_flacMaxPartitionOrder && (_count % (static_cast<size_t>(2) << maxPartitionOrder)) == 0 && (_count >> (maxPartitionOrder + 1)) > static_cast<size_t>(_order))
+			++maxPartitionOrder;
+
+		// sums of the partitions of the highest order, lower orders are computed by merging neighbours
+		const auto partitionCount = static_cast<size_t>(1) << maxPartitionOrder;
+		const auto partitionSize = _count >> maxPartitionOrder;
+
+		m_partitionSums.assign(partitionCount * 2, 0);
+
+		for(size_t p=0; p<partitionCount; ++p)
+		{
+			const auto begin = p == 0 ? static_cast<size_t>(_order) : p * partitionSize;
+			const auto end = (p + 1) * partitionSize;
+
+			uint64_t sum = 0;
+			for(size_t i=begin; i<end; ++i)
+				sum += zigzag(_residual[i]);
+			m_partitionSums[p] = sum;
+		}
+
+		uint64_t bestBits = std::numeric_limits<uint64_t>::max();
+
+		for(auto order = maxPartitionOrder; order >= 0; --order)
+		{
+			const auto count = static_cast<size_t>(1) << order;
+			const auto size = _count >> order;
+
+			RiceCoding coding;
+			coding.partitionOrder = order;
+
+			uint64_t bits = 0;
+			int maxParameter = 0;
+
+			for(size_t p=0; p<count; ++p)
+			{
+				const auto sum = m_partitionSums[p];
+				const auto n = p == 0 ? size - _order : size;
+
+				// the parameter that minimizes n * (k + 1) + sum / 2^k
+				int k = 0;
+				while(k < g_flacMaxRice2Parameter && (static_cast<uint64_t>(n) << (k + 1)) < sum)
+					++k;
+
+				coding.parameters[p] = k;
+				bits += static_cast<uint64_t>(n) * (k + 1) + (sum >> k);
+				maxParameter = std::max(maxParameter, k);
+			}
+
+			coding.parameterBits = maxParameter > g_flacMaxRiceParameter ? 5 : 4;
+			coding.bits = bits + 2 + 4 + count * coding.parameterBits;
+
+			if(coding.bits < bestBits)
+			{
+				bestBits = coding.bits;
+				_coding = coding;
+			}
+
+			// merge for the next lower order
+			for(size_t p=0; p<count/2; ++p)
+				m_partitionSums[p] = m_partitionSums[p * 2] + m_partitionSums[p * 2 + 1];
+		}
+
+		return true;
+	}
+
+	void FrameEncoder::writeResidual(BitWriter& _bw, const int64_t* _residual, const size_t _count, const int _order, const RiceCoding& _coding) const
+	{
+		_bw.write(_coding.parameterBits == 5 ? 1 : 0, 2);
+		_bw.write(_coding.partitionOrder, 4);
+
+		const auto count = static_cast<size_t>(1) << _coding.partitionOrder;
+		const auto size = _count >> _coding.partitionOrder;
+
+		for(size_t p=0; p<count; ++p)
+		{
+			const auto k = _coding.parameters[p];
+			_bw.write(k, _coding.parameterBits);
+
+			const auto begin = p == 0 ? static_cast<size_t>(_order) : p * size;
+			const auto end = (p + 1) * size;
+
+			for(size_t i=begin; i<end; ++i)
+				_bw.writeRice(zigzag(_residual[i]), k);
+		}
+	}
+}
+
+bool FlacWriter::write(const std::string& _filename, const void* _data, const size_t _dataSize, const SampleFormat _format, const int _channelCount, const int _samplerate, asBase::ThreadPool* _pool/* = nullptr*/, const FileIO _io/* = FileIOStdio*/, const FileWriter::Completion& _onComplete/* = nullptr*/)
+{
+	if(_format == SampleFormatFloat32)
+		throw Error(ErrFileFormat, "FLAC does not support floating point samples, can not write " + _filename);
+
+	if(_channelCount < 1 || _channelCount > 8)
+		throw Error(ErrFileFormat, "FLAC supports up to 8 channels, can not write " + _filename);
+
+	const auto bytesPerSample = getSampleSize(_format);
+	const auto bitsPerSample = static_cast<int>(bytesPerSample * 8);
+	const auto channelCount = static_cast<size_t>(_channelCount);
+	const auto totalFrames = _dataSize / (bytesPerSample * channelCount);
+	const auto frameCount = (totalFrames + g_flacBlockSize - 1) / g_flacBlockSize;
+
+	std::vector<std::vector<uint8_t>> frames(frameCount);
+
+	// every job encodes a range of frames with its own scratch buffers
+	const auto jobCount = (frameCount + g_flacFramesPerJob - 1) / g_flacFramesPerJob;
+
+	auto encodeJob = [&](const size_t _job)
+	{
+		FrameEncoder encoder(static_cast<const uint8_t*>(_data), _format, channelCount, bitsPerSample, _samplerate);
+
+		const auto end = std::min(frameCount, (_job + 1) * g_flacFramesPerJob);
+
+		for(auto f=_job * g_flacFramesPerJob; f<end; ++f)
+		{
+			const auto first = f * g_flacBlockSize;
+			encoder.encode(frames[f], f, first, std::min(g_flacBlockSize, totalFrames - first));
+		}
+	};
+
+	if(_pool)
+	{
+		_pool->parallelFor(jobCount, encodeJob);
+	}
+	else
+	{
+		for(size_t j=0; j<jobCount; ++j)
+			encodeJob(j);
+	}
+
+	// stream header and STREAMINFO, the MD5 signature of the audio data is left empty which means 'unknown'
+	size_t minFrameSize = frames.empty() ? 0 : std::numeric_limits<size_t>::max();
+	size_t maxFrameSize = 0;
+
+	for(const auto& f : frames)
+	{
+		minFrameSize = std::min(minFrameSize, f.size());
+		maxFrameSize = std::max(maxFrameSize, f.size());
+	}
+
+	const auto blockSize = totalFrames >= g_flacBlockSize ? g_flacBlockSize : std::max(static_cast<size_t>(16), totalFrames);
+
+	std::vector<uint8_t> header = {'f', 'L', 'a', 'C'};
+	{
+		BitWriter bw(header);
+
+		bw.write(1, 1);			// last metadata block
+		bw.write(0, 7);			// STREAMINFO
+		bw.write(34, 24);
+
+		bw.write(blockSize, 16);
+		bw.write(blockSize, 16);
+		bw.write(minFrameSize < (1 << 24) ? minFrameSize : 0, 24);
+		bw.write(maxFrameSize < (1 << 24) ? maxFrameSize : 0, 24);
+		bw.write(static_cast<uint64_t>(_samplerate), 20);
+		bw.write(channelCount - 1, 3);
+		bw.write(bitsPerSample - 1, 5);
+		bw.write(static_cast<uint64_t>(totalFrames) >> 32, 4);
+		bw.write(static_cast<uint64_t>(totalFrames), 32);
+
+		for(int i=0; i<4; ++i)
+			bw.write(0, 32);
+	}
+
+	std::vector<FileWriter::Buffer> buffers;
+	buffers.reserve(frames.size() + 1);
+
+	buffers.push_back({header.data(), header.size()});
+
+	for(const auto& f : frames)
+		buffers.push_back({f.data(), f.size()});
+
+	if(_onComplete && FileWriter::isAsync(_io))
+	{
+		// the buffers point into the vectors, moving them keeps the addresses
+		auto encoded = std::make_shared<std::pair<std::vector<uint8_t>, std::vector<std::vector<uint8_t>>>>(std::move(header), std::move(frames));
+
+		FileWriter::writeAsync(_filename, buffers, [encoded, _onComplete](const bool _success)
+		{
+			_onComplete(_success);
+		});
+
+		return true;
+	}
+
+	return FileWriter::write(_filename, buffers, _io);
+}
+
+bool FlacWriter::isFlacFilename(const std::string& _filename)
+{
+	const std::string extension = ".flac";
+
+	if(_filename.size() < extension.size())
+		return false;
+
+	return std::equal(extension.begin(), extension.end(), _filename.end() - extension.size(), [](const char _a, const char _b)
+	{
+		return _a == ::tolower(static_cast<unsigned char>(_b));
+	});
+}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "fileWriter.h"
+#include "sampleConverter.h"
+
+namespace asBase
+{
+	class ThreadPool;
+}
+
+namespace asLib
+{
+	// Lossless FLAC encoder for integer samples. Uses fixed and LPC prediction with Rice coded residuals and stereo
+	// decorrelation. Frames do not depend on each other, they are encoded in parallel if a thread pool is given
+	class FlacWriter
+	{
+	public:
+		// throws if the sample format is floating point, returns false if the file cannot be written. Asynchronous writes
+		// behave as in WavWriter::write, the encoded frames are kept until the write has completed
+		static bool write(const std::string& _filename, const void* _data, size_t _dataSize, SampleFormat _format, int _channelCount, int _samplerate, asBase::ThreadPool* _pool = nullptr, FileIO _io = FileIOStdio, const FileWriter::Completion& _onComplete = nullptr);
+
+		// the output format is chosen by the extension of the filename
+		static bool isFlacFilename(const std::string& _filename);
+	};
+}
@@ -0,0 +1,303 @@
+#include "midiFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+
+#include "error.h"
+#include "midiTypes.h"
+
+namespace asLib
+{
+constexpr uint32_t g_defaultTempo = 500000;		// microseconds per quarter note, 120 bpm
+
+namespace
+{
+	enum EventType
+	{
+		EventTempo,
+		EventNoteOn,
+		EventNoteOff,
+		EventProgramChange,
+		EventControlChange,
+	};
+
+	struct Event
+	{
+		uint64_t tick;
+		size_t order;			// keeps the file order for events on the same tick
+		EventType type;
+		uint8_t channel;
+		uint8_t data1;
+		uint8_t data2;
+		uint32_t tempo;
+	};
+
+	class Reader
+	{
+	public:
+		Reader(const std::vector<uint8_t>& _data, const std::string& _filename) : m_data(_data), m_filename(_filename) {}
+
+		bool eof() const				{ return m_pos >= m_end; }
+		size_t pos() const				{ return m_pos; }
+		void limit(const size_t _end)	{ m_end = std::min(_end, m_data.size()); }
+		void seek(const size_t _pos)	{ m_pos = _pos; }
+
+		uint8_t u8()
+		{
+			if(m_pos >= m_end)
+				throw Error(ErrFileFormat, "Unexpected end of MIDI file " + m_filename);
+			return m_data[m_pos++];
+		}
+
+		uint32_t u16()					{ const uint32_t a = u8(); return a << 8 | u8(); }
+		uint32_t u32()					{ const auto a = u16(); return a << 16 | u16(); }
+
+		uint32_t varLen()
+		{
+			uint32_t result = 0;
+			for(auto i=0; i<4; ++i)
+			{
+				const auto b = u8();
+				result = (result << 7) | (b & 0x7f);
+				if(!(b & 0x80))
+					return result;
+			}
+			throw Error(ErrFileFormat, "Invalid variable length quantity in MIDI file " + m_filename);
+		}
+
+		void skip(const size_t _count)
+		{
+			if(_count > m_end - m_pos)
+				throw Error(ErrFileFormat, "Unexpected end of MIDI file " + m_filename);
+			m_pos += _count;
+		}
+
+		bool tag(const char* _tag)
+		{
+			if(m_pos + 4 > m_data.size() || memcmp(&m_data[m_pos], _tag, 4) != 0)
+				return false;
+			m_pos += 4;
+			return true;
+		}
+
+	private:
+		const std::vector<uint8_t>& m_data;
+		const std::string& m_filename;
+		size_t m_pos = 0;
+		size_t m_end = std::numeric_limits<size_t>::max();
+	};
+
+	void readTrack(Reader& _reader, std::vector<Event>& _events)
+	{
+		uint64_t tick = 0;
+		uint8_t runningStatus = 0;
+
+		while(!_reader.eof())
+		{
+			tick += _reader.varLen();
+
+			auto status = _reader.u8();
+
+			if(status == 0xff)
+			{
+				// meta event
+				const auto type = _reader.u8();
+				const auto length = _reader.varLen();
+
+				if(type == 0x51 && length == 3)
+				{
+					const uint32_t a = _reader.u8();
+					const uint32_t b = _reader.u8();
+					const uint32_t c = _reader.u8();
+					_events.push_back(Event{tick, _events.size(), EventTempo, 0, 0, 0, a << 16 | b << 8 | c});
+				}
+				else if(type == 0x2f)
+				{
+					break;	// end of track
+				}
+				else
+				{
+					_reader.skip(length);
+				}
+				continue;
+			}
+
+			if(status == M_STARTOFSYSEX || status == M_ENDOFSYSEX)
+			{
+				_reader.skip(_reader.varLen());
+				continue;
+			}
+
+			uint8_t data1;
+
+			if(status & 0x80)
+			{
+				runningStatus = status;
+				data1 = _reader.u8();
+			}
+			else
+			{
+				if(!runningStatus)
+					throw Error(ErrFileFormat, "Invalid running status in MIDI file");
+				data1 = status;
+				status = runningStatus;
+			}
+
+			const uint8_t channel = status & 0x0f;
+
+			switch (status & 0xf0)
+			{
+			case M_NOTEON:
+				{
+					const auto velocity = _reader.u8();
+					_events.push_back(Event{tick, _events.size(), velocity ? EventNoteOn : EventNoteOff, channel, data1, velocity, 0});
+				}
+				break;
+			case M_NOTEOFF:
+				_events.push_back(Event{tick, _events.size(), EventNoteOff, channel, data1, _reader.u8(), 0});
+				break;
+			case M_CONTROLCHANGE:
+				_events.push_back(Event{tick, _events.size(), EventControlChange, channel, data1, _reader.u8(), 0});
+				break;
+			case M_PROGRAMCHANGE:
+				_events.push_back(Event{tick, _events.size(), EventProgramChange, channel, data1, 0, 0});
+				break;
+			case M_AFTERTOUCH:
+				break;	// single data byte
+			default:
+				_reader.u8();
+				break;
+			}
+		}
+	}
+}
+
+MidiFile::MidiFile(const std::string& _filename)
+{
+	std::ifstream file(_filename, std::ios::binary);
+
+	if(!file.is_open())
+		throw Error(ErrFileIO, "Failed to open file " + _filename);
+
+	const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Reader reader(data, _filename);
+
+	if(!reader.tag("MThd"))
+		throw Error(ErrFileFormat, "Not a MIDI file: " + _filename);
+
+	const auto headerSize = reader.u32();
+	const auto headerEnd = reader.pos() + headerSize;
+	reader.u16();	// format, all tracks are merged anyway
+	const auto trackCount = reader.u16();
+	const auto division = reader.u16();
+	reader.seek(headerEnd);
+
+	if(division == 0)
+		throw Error(ErrFileFormat, "Invalid time division in MIDI file " + _filename);
+
+	std::vector<Event> events;
+
+	for(uint32_t t=0; t<trackCount && reader.pos() < data.size(); ++t)
+	{
+		// skip unknown chunks
+		while(!reader.tag("MTrk"))
+		{
+			reader.skip(4);
+			reader.skip(reader.u32());
+		}
+
+		const auto trackSize = reader.u32();
+		const auto trackEnd = reader.pos() + trackSize;
+
+		reader.limit(trackEnd);
+		readTrack(reader, events);
+		reader.limit(data.size());
+		reader.seek(trackEnd);
+	}
+
+	std::sort(events.begin(), events.end(), [](const Event& _a, const Event& _b)
+	{
+		return _a.tick < _b.tick || (_a.tick == _b.tick && _a.order < _b.order);
+	});
+
+	// ticks => seconds. SMPTE divisions have a fixed tick length, otherwise it depends on the current tempo
+	const auto smpte = (division & 0x8000) != 0;
+	const auto smpteSecondsPerTick = smpte ? 1.0 / (static_cast<double>(-static_cast<int8_t>(division >> 8)) * static_cast<double>(division & 0xff)) : 0.0;
+
+	uint32_t tempo = g_defaultTempo;
+	uint64_t lastTick = 0;
+	double seconds = 0.0;
+
+	uint8_t programs[16];
+	std::fill(std::begin(programs), std::end(programs), 0xff);
+
+	// current controller values per channel, a copy is stored when a note starts after they have changed
+	std::vector<uint8_t> controllers(16 * ControllerCount, 0);
+	uint32_t controllerSets[16];
+	std::fill(std::begin(controllerSets), std::end(controllerSets), 0);
+	bool controllersChanged[16];
+	std::fill(std::begin(controllersChanged), std::end(controllersChanged), true);
+
+	// notes that have been started but not stopped, per channel and key
+	std::map<uint16_t, std::deque<size_t>> playingNotes;
+
+	for(const auto& e : events)
+	{
+		const auto ticks = static_cast<double>(e.tick - lastTick);
+		seconds += smpte ? ticks * smpteSecondsPerTick : ticks * static_cast<double>(tempo) / (1000000.0 * static_cast<double>(division));
+		lastTick = e.tick;
+
+		const uint16_t key = static_cast<uint16_t>(e.channel << 8 | e.data1);
+
+		switch (e.type)
+		{
+		case EventTempo:
+			tempo = e.tempo;
+			break;
+		case EventProgramChange:
+			programs[e.channel] = e.data1;
+			break;
+		case EventControlChange:
+			if(e.data1 < ControllerCount)
+			{
+				controllers[e.channel * ControllerCount + e.data1] = e.data2;
+				controllersChanged[e.channel] = true;
+			}
+			break;
+		case EventNoteOn:
+			if(controllersChanged[e.channel])
+			{
+				const auto* values = &controllers[e.channel * ControllerCount];
+				controllerSets[e.channel] = static_cast<uint32_t>(m_controllers.size() / ControllerCount);
+				m_controllers.insert(m_controllers.end(), values, values + ControllerCount);
+				controllersChanged[e.channel] = false;
+			}
+			playingNotes[key].push_back(m_notes.size());
+			m_notes.push_back(Note{e.channel, e.data1, e.data2, programs[e.channel], seconds, seconds, controllerSets[e.channel]});
+			break;
+		case EventNoteOff:
+			{
+				auto& playing = playingNotes[key];
+				if(playing.empty())
+					break;
+				m_notes[playing.front()].end = seconds;
+				playing.pop_front();
+			}
+			break;
+		}
+	}
+
+	// notes that are never released last until the end of the file
+	for(auto& it : playingNotes)
+	{
+		for(auto index : it.second)
+			m_notes[index].end = seconds;
+	}
+}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace asLib
+{
+	// Reads the notes of a Standard MIDI File (format 0 and 1). Tick positions are converted to seconds using the tempo map of the file
+	class MidiFile
+	{
+	public:
+		static constexpr size_t ControllerCount = 128;
+
+		struct Note
+		{
+			uint8_t channel;
+			uint8_t note;
+			uint8_t velocity;
+			uint8_t program;		// last program change on the channel before the note started, 0xff if there was none
+			double start;			// seconds
+			double end;
+			uint32_t controllers;	// controller values of the channel when the note started, see getControllers
+		};
+
+		// throws if the file cannot be read or is not a valid MIDI file
+		explicit MidiFile(const std::string& _filename);
+
+		// sorted by start time
+		const std::vector<Note>& getNotes() const	{ return m_notes; }
+
+		// ControllerCount values, 0 for controllers that have not been sent
+		const uint8_t* getControllers(const Note& _note) const	{ return &m_controllers[_note.controllers * ControllerCount]; }
+
+	private:
+		std::vector<Note> m_notes;
+		std::vector<uint8_t> m_controllers;	// one set of ControllerCount values per change, shared by the notes that follow it
+	};
+}
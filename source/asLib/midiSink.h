@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+
+namespace asLib
+{
+	// Receives the MIDI events that are played by the instrument that is being recorded
+	class MidiSink
+	{
+	public:
+		virtual ~MidiSink() = default;
+
+		// _time is the time at which the event is to be played, in seconds measured with the clock of the AudioSource. 0 plays it immediately
+		virtual void send(uint8_t _status, uint8_t _data1, uint8_t _data2, double _time) = 0;
+	};
+}
@@ -0,0 +1,194 @@
+#include "offlineSlicer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "audioDataPool.h"
+#include "autosampler.h"
+#include "directoryCache.h"
+#include "error.h"
+#include "fileWriter.h"
+#include "midiFile.h"
+#include "wavReader.h"
+
+#include "../asBase/logging.h"
+#include "../asBase/threadPool.h"
+
+namespace asLib
+{
+OfflineSlicer::OfflineSlicer(Config _config) : m_config(std::move(_config))
+{
+}
+
+void OfflineSlicer::run()
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	const WavReader wav(m_config.sliceAudioFile);
+	const MidiFile midi(m_config.sliceMidiFile);
+
+	const auto samplerate = wav.getSamplerate();
+	const auto frameCount = wav.getFrameCount();
+	const auto& notes = midi.getNotes();
+
+	LOG("Slicing " << wav.getFilename() << ": " << frameCount << " frames, " << samplerate << " Hz, " << wav.getChannelCount() << " channels, " << notes.size() << " notes");
+
+	if(notes.empty())
+		return;
+
+	auto toFrame = [&](const double _seconds)
+	{
+		return std::min(frameCount, static_cast<size_t>(std::llround(std::max(0.0, _seconds) * samplerate)));
+	};
+
+	// the recording before the first note is used to detect the noise floor
+	const auto noiseFloorFrames = std::min(toFrame(notes.front().start), static_cast<size_t>(m_config.detectNoisefloorDuration * samplerate));
+
+	float noiseFloor = 0.0f;
+
+	if(noiseFloorFrames > 0)
+		noiseFloor = SampleConverter::peak(toSampleFormat(wav.getSampleFormat()), wav.getData(), noiseFloorFrames * wav.getChannelCount());
+	else
+		LOG_WARNING("no silence before the first note, samples are not trimmed");
+
+	LOG("Noise floor is " << noiseFloor);
+
+	const auto releaseFrames = static_cast<size_t>(m_config.releaseLength * samplerate);
+
+	const auto threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// every job acquires a buffer while it runs, there are never more jobs running than threads
+	AudioDataPool buffers(wav.getSampleFormat(), wav.getChannelCount(), 0, threadCount);
+	asBase::ThreadPool pool(threadCount, threadCount * 2);
+
+	std::atomic<size_t> writtenCount{0};
+
+	DirectoryCache directories;
+	const FilenameTemplate filenameTemplate(m_config.filename);
+
+	// {layer} is the index of the velocity among all velocities that are played, {round} counts the repetitions of a note
+	bool velocitiesPlayed[128] = {};
+
+	for(const auto& note : notes)
+		velocitiesPlayed[note.velocity & 0x7f] = true;
+
+	int layers[128];
+
+	for(int v=0, layer=0; v<128; ++v)
+	{
+		layers[v] = layer;
+		if(velocitiesPlayed[v])
+			++layer;
+	}
+
+	std::unordered_map<uint32_t, int> rounds;
+
+	std::shared_ptr<SessionJournal> journal;
+
+	if(!m_config.journalFile.empty())
+		journal.reset(new SessionJournal(m_config.journalFile));
+
+	for(size_t i=0; i<notes.size(); ++i)
+	{
+		const auto& note = notes[i];
+
+		// a sample lasts until the release time has passed after note off, but does not include the next note
+		const auto start = toFrame(note.start);
+		auto end = std::min(frameCount, toFrame(note.end) + releaseFrames);
+
+		if(i + 1 < notes.size())
+			end = std::min(end, std::max(start, toFrame(notes[i+1].start)));
+
+		if(end <= start)
+		{
+			LOG("Skipping note " << static_cast<int>(note.note) << " at " << note.start << "s, it is outside of the recording");
+			continue;
+		}
+
+		AutoSampler::Voice voice;
+		voice.note = note.note;
+		voice.velocity = note.velocity;
+		voice.program = note.program;
+		voice.channel = note.channel;
+		voice.layer = layers[note.velocity & 0x7f];
+		voice.round = rounds[static_cast<uint32_t>(note.channel) << 24 | static_cast<uint32_t>(note.program) << 16 | static_cast<uint32_t>(note.note) << 8 | note.velocity]++;
+		voice.controllers = midi.getControllers(note);
+
+		const auto filename = AutoSampler::createFilename(filenameTemplate, voice, m_config.deviceIndex);
+
+		if(m_config.skipExistingFiles)
+		{
+			if(journal)
+			{
+				if(journal->contains(filename))
+				{
+					LOG("Skipping file " << filename << ", already exists")
+					continue;
+				}
+			}
+			else
+			{
+				FILE* hFile = fopen(filename.c_str(), "rb");
+				if(hFile)
+				{
+					fclose(hFile);
+					LOG("Skipping file " << filename << ", already exists")
+					continue;
+				}
+			}
+		}
+
+		directories.createDirectories(filename);
+
+		pool.push([&, filename, start, end, voice]
+		{
+			auto* data = buffers.acquire();
+			auto pending = false;
+
+			try
+			{
+				data->append(wav.getFrame(start), end - start);
+				pending = AutoSampler::writeWaveFile(filename, data, noiseFloor, samplerate, m_config.fileIO, &pool, [&buffers, data] { buffers.release(data); }, journal, voice);
+			}
+			catch(...)
+			{
+				buffers.release(data);
+				throw;
+			}
+
+			if(!pending)
+				buffers.release(data);
+			++writtenCount;
+		});
+	}
+
+	// asynchronous writes use the buffers until they have completed, wait for them in any case
+	try
+	{
+		pool.waitIdle();
+	}
+	catch(...)
+	{
+		FileWriter::waitAsync();
+		throw;
+	}
+
+	const auto failedWrites = FileWriter::waitAsync();
+
+	if(failedWrites)
+	{
+		std::stringstream ss; ss << failedWrites << " files could not be written";
+		throw Error(ErrFileIO, ss);
+	}
+
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	LOG("Sliced " << writtenCount << " samples in " << seconds << " seconds");
+}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "config.h"
+
+namespace asLib
+{
+	// Cuts a long recording of a whole session into individual samples, using the MIDI file that has been played
+	// during the recording. Every note is trimmed and named the same way as during a live session, notes are
+	// processed in parallel
+	class OfflineSlicer
+	{
+	public:
+		explicit OfflineSlicer(Config _config);
+
+		void run();
+
+	private:
+		const Config m_config;
+	};
+}
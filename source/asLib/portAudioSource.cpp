@@ -0,0 +1,174 @@
+#include "portAudioSource.h"
+
+#include <chrono>
+
+#include "config.h"
+#include "error.h"
+
+#include "../asBase/logging.h"
+
+namespace asLib
+{
+PortAudioSource::PortAudioSource(const Config& _config)
+{
+	Pa_Initialize();
+
+	std::vector<AudioDeviceInfo> audioDevices;
+	getDevices(audioDevices);
+
+	std::vector<PaDeviceIndex> matchingDevices;
+	matchingDevices.reserve(audioDevices.size());
+	
+	for (auto i = 0; i < audioDevices.size(); ++i)
+	{
+		const auto& devInfo = audioDevices[i];
+
+		if(devInfo.maxChannels <= _config.inputChannels)
+			continue;
+
+		if(!devInfo.matches(_config.inputDevice, _config.inputHostApi))
+			continue;
+
+		LOG("Audio Input Device " << i << " [" << devInfo.api << "]: " << devInfo.name << ", default samplerate " << devInfo.maxSamplerate << ", max input channels " << devInfo.maxChannels)
+
+		matchingDevices.push_back(devInfo.id);
+	}
+
+	if(matchingDevices.empty())
+	{
+		Pa_Terminate();
+		throw Error(ErrInputDeviceNotFound, "No input device found");
+	}
+
+	const auto& device = matchingDevices.back();
+
+	PaStreamParameters inputParameters{};
+	inputParameters.channelCount = _config.inputChannels;
+	inputParameters.device = device;
+	inputParameters.sampleFormat = bitCountToSampleFormat(_config.inputBits);
+
+	auto err=  Pa_IsFormatSupported(&inputParameters, nullptr, _config.inputSamplerate);
+
+	if(err != paNoError)
+	{
+		Pa_Terminate();
+		throw Error(ErrAudioInput, std::string("Audio Input subsystem returned error: ") + Pa_GetErrorText(err));
+	}
+
+	const auto streamFlags = (inputParameters.sampleFormat == paFloat32) ? paClipOff : paNoFlag;
+
+	err = Pa_OpenStream(&m_stream, &inputParameters, nullptr, _config.inputSamplerate, _config.inputBlockSize, streamFlags, portAudioCallback, this);
+
+	if(err != paNoError)
+	{
+		Pa_Terminate();
+		throw Error(ErrAudioInput, std::string("Audio Input subsystem returned error: ") + Pa_GetErrorText(err));
+	}
+
+	const auto* streamInfo = Pa_GetStreamInfo(m_stream);
+
+	// I've seen that the SR is something different than we wanted, check it
+	if(static_cast<int>(streamInfo->sampleRate) != _config.inputSamplerate)
+	{
+		std::stringstream ss; ss << "Failed to set samplerate, requested was " << _config.inputSamplerate << " but we've got " << streamInfo->sampleRate;
+		stop();
+		Pa_Terminate();
+		throw Error(ErrAudioInput, ss);
+	}
+	
+	m_samplerate = static_cast<float>(streamInfo->sampleRate);
+	m_sampleFormat = inputParameters.sampleFormat;
+	m_channelCount = static_cast<size_t>(_config.inputChannels);
+}
+
+PortAudioSource::~PortAudioSource()
+{
+	stop();
+	Pa_Terminate();
+}
+
+void PortAudioSource::start(Callback _callback)
+{
+	m_callback = std::move(_callback);
+
+	const auto err = Pa_StartStream(m_stream);
+
+	if(err != paNoError)
+		throw Error(ErrAudioInput, std::string("Audio Input subsystem returned error: ") + Pa_GetErrorText(err));
+}
+
+void PortAudioSource::stop()
+{
+	if(!m_stream)
+		return;
+
+	Pa_CloseStream(m_stream);
+	m_stream = nullptr;
+}
+
+double PortAudioSource::getTime() const
+{
+	return Pa_GetStreamTime(m_stream);
+}
+
+double PortAudioSource::getCpuLoad() const
+{
+	// measured by PortAudio (pa_cpuload), averaged over recent callbacks
+	return m_stream ? Pa_GetStreamCpuLoad(m_stream) : 0.0;
+}
+
+bool PortAudioSource::getDevices(std::vector<AudioDeviceInfo>& _audioInputs)
+{
+	Pa_Initialize();
+
+	const auto devCount = Pa_GetDeviceCount();
+
+	if(devCount < 0)
+	{
+		Pa_Terminate();
+		return false;
+	}
+
+	_audioInputs.reserve(devCount);
+
+	for (auto i = 0; i < devCount; ++i)
+	{
+		const auto* devInfo = Pa_GetDeviceInfo(i);
+		const auto* hostApi = Pa_GetHostApiInfo(devInfo->hostApi);
+
+		if(devInfo->maxInputChannels <= 0)
+			continue;
+
+		AudioDeviceInfo di;
+		
+		di.name = devInfo->name;
+		di.api = hostApi->name;
+		di.id = i;
+
+		di.maxChannels = devInfo->maxInputChannels;
+		di.maxSamplerate = static_cast<int>(devInfo->defaultSampleRate);
+
+		_audioInputs.emplace_back(std::move(di));
+	}
+
+	Pa_Terminate();
+	return true;
+}
+
+int PortAudioSource::portAudioCallback(const void* _inputBuffer, void*, const unsigned long _framesPerBuffer, const PaStreamCallbackTimeInfo* _timeInfo, const PaStreamCallbackFlags _statusFlags, void* _userData)
+{
+	auto* source = static_cast<PortAudioSource*>(_userData);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	const auto overflow = (_statusFlags & paInputOverflow) != 0;
+
+	const auto result = source->m_callback(_inputBuffer, _framesPerBuffer, _timeInfo ? _timeInfo->inputBufferAdcTime : 0.0, overflow);
+
+	const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	source->m_callbackMetrics.add(duration, static_cast<double>(_framesPerBuffer) / static_cast<double>(source->m_samplerate), overflow);
+
+	return result ? paContinue : paComplete;
+}
+}
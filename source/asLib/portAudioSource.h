@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "audioSource.h"
+#include "deviceInfo.h"
+#include "sessionMetrics.h"
+
+#include "../portaudio/include/portaudio.h"
+
+namespace asLib
+{
+	struct Config;
+
+	// Records from an audio input device via PortAudio
+	class PortAudioSource : public AudioSource
+	{
+	public:
+		explicit PortAudioSource(const Config& _config);
+		PortAudioSource(const PortAudioSource&) = delete;
+		~PortAudioSource() override;
+
+		void start(Callback _callback) override;
+		void stop() override;
+
+		double getTime() const override;
+		float getSamplerate() const override				{ return m_samplerate; }
+		unsigned long getSampleFormat() const override		{ return m_sampleFormat; }
+		size_t getChannelCount() const override				{ return m_channelCount; }
+
+		const CallbackMetrics* getCallbackMetrics() const override	{ return &m_callbackMetrics; }
+		double getCpuLoad() const override;
+
+		static bool getDevices(std::vector<AudioDeviceInfo>& _audioInputs);
+
+		PortAudioSource& operator = (const PortAudioSource&) = delete;
+
+	private:
+		static int portAudioCallback(const void* _inputBuffer, void*, unsigned long _framesPerBuffer, const PaStreamCallbackTimeInfo* _timeInfo, PaStreamCallbackFlags _statusFlags, void* _userData);
+
+		PaStream* m_stream = nullptr;
+		Callback m_callback;
+
+		float m_samplerate = 0.0f;
+		unsigned long m_sampleFormat = 0;
+		size_t m_channelCount = 0;
+
+		CallbackMetrics m_callbackMetrics;
+	};
+}
@@ -0,0 +1,137 @@
+#include "portMidiSink.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "audioSource.h"
+#include "config.h"
+#include "error.h"
+
+#include "../asBase/logging.h"
+
+#include "../portmidi/pm_common/portmidi.h"
+#include "../portmidi/porttime/porttime.h"
+
+namespace asLib
+{
+constexpr int32_t g_midiLatencyMs = 1;				// needs to be > 0, otherwise PortMidi ignores timestamps
+
+// PortMidi and PortTime are global, they are shared by all sinks of a session and stopped once the last one is closed.
+// They are not thread safe, on Linux all outputs share one ALSA sequencer handle. Every call is made with g_portMidiMutex
+// locked, the samplers of a session send from their own capture threads
+static std::mutex g_portMidiMutex;
+static int g_sinkCount = 0;
+
+PortMidiSink::PortMidiSink(const Config& _config, const AudioSource& _clock) : m_clock(_clock)
+{
+	std::vector<DeviceInfo> midiDevices;
+	getDevices(midiDevices);
+
+	std::vector<int> matchingDevices;
+
+	for(auto i=0; i<midiDevices.size(); ++i)
+	{
+		const auto& devInfo = midiDevices[i];
+
+		if(!devInfo.matches(_config.midiOutputDevice, _config.midiOutputApi))
+			continue;
+
+		LOG("MIDI device " << i << ": [" << devInfo.api << "]: " << devInfo.name);
+
+		matchingDevices.push_back(devInfo.id);
+	}
+
+	if(matchingDevices.empty())
+		throw Error(ErrMidiOutputNotFound, "No matching midi output device found");
+
+	const auto& device = matchingDevices.back();
+
+	std::lock_guard<std::mutex> lock(g_portMidiMutex);
+
+	// we schedule events with PortTime timestamps, the timer has to be running before the output is opened
+	if(!Pt_Started())
+		Pt_Start(1, nullptr, nullptr);
+
+	const auto err = Pm_OpenOutput(&m_stream, device, nullptr, 64, nullptr, nullptr, g_midiLatencyMs);
+
+	if(err != pmNoError)
+		throw Error(ErrMidiOutput, std::string("Midi Output subsystem returned error: ") + Pm_GetErrorText(err));
+
+	++g_sinkCount;
+}
+
+PortMidiSink::~PortMidiSink()
+{
+	std::lock_guard<std::mutex> lock(g_portMidiMutex);
+
+	if(m_stream)
+	{
+		Pm_Close(m_stream);
+		m_stream = nullptr;
+	}
+
+	if(--g_sinkCount > 0)
+		return;
+
+	if(Pt_Started())
+		Pt_Stop();
+
+	Pm_Terminate();
+}
+
+void PortMidiSink::send(const uint8_t _status, const uint8_t _data1, const uint8_t _data2, const double _time)
+{
+	int32_t timestamp = 0;
+
+	std::lock_guard<std::mutex> lock(g_portMidiMutex);
+
+	if(_time > 0.0)
+	{
+		// audio source time => PortTime
+		const auto now = Pt_Time();
+		const auto streamTimeToPortTime = static_cast<double>(now) - m_clock.getTime() * 1000.0;
+
+		const auto time = static_cast<int32_t>(std::floor(_time * 1000.0 + streamTimeToPortTime + 0.5));
+
+		if(time < now)
+			LOG_WARNING("MIDI event is " << (now - time) << " ms late");
+
+		// PortMidi delays output by its latency, a timestamp of 0 would mean 'now'
+		timestamp = std::max(time - g_midiLatencyMs, 1);
+	}
+
+	const auto err = Pm_WriteShort(m_stream, timestamp, Pm_Message(_status, _data1, _data2));
+
+	if(err != pmNoError)
+		throw Error(ErrMidiOutput, std::string("Midi Output subsystem returned error: ") + Pm_GetErrorText(err));
+}
+
+bool PortMidiSink::getDevices(std::vector<DeviceInfo>& _midiOutputs)
+{
+	std::lock_guard<std::mutex> lock(g_portMidiMutex);
+
+	Pm_Initialize();
+
+	const auto devCount = Pm_CountDevices();
+
+	if(devCount < 0)
+		return false;
+
+	for(auto i=0; i<devCount; ++i)
+	{
+		const auto* devInfo = Pm_GetDeviceInfo(i);
+
+		if(!devInfo->output)
+			continue;
+
+		DeviceInfo di;
+		di.name = devInfo->name;
+		di.api = devInfo->interf;
+		di.id = i;
+
+		_midiOutputs.emplace_back(std::move(di));
+	}
+	return true;
+}
+}
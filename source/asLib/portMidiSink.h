@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "deviceInfo.h"
+#include "midiSink.h"
+
+namespace asLib
+{
+	class AudioSource;
+	struct Config;
+
+	// Sends MIDI to an output device via PortMidi. Events are scheduled with PortTime timestamps, which are derived
+	// from the clock of the audio source
+	class PortMidiSink : public MidiSink
+	{
+	public:
+		PortMidiSink(const Config& _config, const AudioSource& _clock);
+		PortMidiSink(const PortMidiSink&) = delete;
+		~PortMidiSink() override;
+
+		void send(uint8_t _status, uint8_t _data1, uint8_t _data2, double _time) override;
+
+		static bool getDevices(std::vector<DeviceInfo>& _midiOutputs);
+
+		PortMidiSink& operator = (const PortMidiSink&) = delete;
+
+	private:
+		const AudioSource& m_clock;
+		void* m_stream = nullptr;
+	};
+}
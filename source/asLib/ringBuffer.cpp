@@ -0,0 +1,72 @@
+#include "ringBuffer.h"
+
+#include <cassert>
+
+namespace asLib
+{
+static size_t nextPowerOfTwo(size_t _value)
+{
+	size_t result = 1;
+	while(result < _value)
+		result <<= 1;
+	return result;
+}
+
+RingBuffer::RingBuffer(const size_t _elementSize, const size_t _elementCount) : m_elementSize(_elementSize), m_ringBuffer()
+{
+	const auto elementCount = nextPowerOfTwo(_elementCount);
+
+	m_storage.resize(elementCount * _elementSize);
+
+	const auto res = PaUtil_InitializeRingBuffer(&m_ringBuffer, static_cast<ring_buffer_size_t>(_elementSize), static_cast<ring_buffer_size_t>(elementCount), &m_storage[0]);
+	assert(res == 0);
+	(void)res;
+}
+
+size_t RingBuffer::write(const void* _data, const size_t _elementCount)
+{
+	return static_cast<size_t>(PaUtil_WriteRingBuffer(&m_ringBuffer, _data, static_cast<ring_buffer_size_t>(_elementCount)));
+}
+
+size_t RingBuffer::read(void* _data, const size_t _elementCount)
+{
+	return static_cast<size_t>(PaUtil_ReadRingBuffer(&m_ringBuffer, _data, static_cast<ring_buffer_size_t>(_elementCount)));
+}
+
+size_t RingBuffer::getReadRegions(const size_t _elementCount, const void*& _data1, size_t& _size1, const void*& _data2, size_t& _size2)
+{
+	void* data1 = nullptr;
+	void* data2 = nullptr;
+	ring_buffer_size_t size1 = 0;
+	ring_buffer_size_t size2 = 0;
+
+	const auto count = PaUtil_GetRingBufferReadRegions(&m_ringBuffer, static_cast<ring_buffer_size_t>(_elementCount), &data1, &size1, &data2, &size2);
+
+	_data1 = data1;
+	_data2 = data2;
+	_size1 = static_cast<size_t>(size1);
+	_size2 = static_cast<size_t>(size2);
+
+	return static_cast<size_t>(count);
+}
+
+void RingBuffer::advanceReadIndex(const size_t _elementCount)
+{
+	PaUtil_AdvanceRingBufferReadIndex(&m_ringBuffer, static_cast<ring_buffer_size_t>(_elementCount));
+}
+
+size_t RingBuffer::readAvailable() const
+{
+	return static_cast<size_t>(PaUtil_GetRingBufferReadAvailable(&m_ringBuffer));
+}
+
+size_t RingBuffer::writeAvailable() const
+{
+	return static_cast<size_t>(PaUtil_GetRingBufferWriteAvailable(&m_ringBuffer));
+}
+
+void RingBuffer::flush()
+{
+	PaUtil_FlushRingBuffer(&m_ringBuffer);
+}
+}
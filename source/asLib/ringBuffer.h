@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "../portaudio/src/common/pa_ringbuffer.h"
+
+namespace asLib
+{
+	// Single reader / single writer lock-free FIFO, wraps the PortAudio ring buffer implementation.
+	// The writer side is wait-free and never allocates, it is safe to be used from an audio callback
+	class RingBuffer
+	{
+	public:
+		// element count is rounded up to the next power of two
+		RingBuffer(size_t _elementSize, size_t _elementCount);
+		RingBuffer(const RingBuffer&) = delete;
+
+		size_t write(const void* _data, size_t _elementCount);
+		size_t read(void* _data, size_t _elementCount);
+
+		// access data in place without copying it, call advanceReadIndex() once the data has been consumed
+		size_t getReadRegions(size_t _elementCount, const void*& _data1, size_t& _size1, const void*& _data2, size_t& _size2);
+		void advanceReadIndex(size_t _elementCount);
+
+		size_t readAvailable() const;
+		size_t writeAvailable() const;
+
+		size_t capacity() const				{ return static_cast<size_t>(m_ringBuffer.bufferSize); }
+		size_t elementSize() const			{ return m_elementSize; }
+
+		void flush();
+
+		RingBuffer& operator = (const RingBuffer&) = delete;
+
+	private:
+		const size_t m_elementSize;
+		std::vector<uint8_t> m_storage;
+		PaUtilRingBuffer m_ringBuffer;
+	};
+}
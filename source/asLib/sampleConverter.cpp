@@ -0,0 +1,601 @@
+#include "sampleConverter.h"
+#include "error.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../portaudio/include/portaudio.h"
+
+#if defined(__AVX2__)
+#	define AS_SIMD_AVX2
+#	include <immintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(AS_SIMD_AVX2)
+#	define AS_SIMD_SSSE3
+#	include <tmmintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define AS_SIMD_SSE2
+#	include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#	define AS_SIMD_NEON
+#	include <arm_neon.h>
+#endif
+
+namespace asLib
+{
+SampleFormat toSampleFormat(const unsigned long _portAudioFormat)
+{
+	switch (_portAudioFormat)
+	{
+	case paInt8:	return SampleFormatInt8;
+	case paUInt8:	return SampleFormatUInt8;
+	case paInt16:	return SampleFormatInt16;
+	case paInt24:	return SampleFormatInt24;
+	case paInt32:	return SampleFormatInt32;
+	case paFloat32:	return SampleFormatFloat32;
+	default:
+		throw Error(ErrAudioInput, "Unknown stream format");
+	}
+}
+
+size_t getSampleSize(const SampleFormat _format)
+{
+	switch (_format)
+	{
+	case SampleFormatInt8:
+	case SampleFormatUInt8:		return 1;
+	case SampleFormatInt16:		return 2;
+	case SampleFormatInt24:		return 3;
+	case SampleFormatInt32:
+	case SampleFormatFloat32:	return 4;
+	}
+	return 0;
+}
+
+namespace
+{
+	constexpr size_t g_blockSize = 256;		// samples that are converted at once to compute statistics
+
+	constexpr float g_scaleInt8 = 1.0f / 128.0f;
+	constexpr float g_scaleInt16 = 1.0f / 32768.0f;
+	constexpr float g_scaleInt24 = 1.0f / 8388608.0f;
+	constexpr float g_scaleInt32 = 1.0f / 2147483648.0f;
+
+	template<SampleFormat F> struct FormatTraits;
+	template<> struct FormatTraits<SampleFormatInt8>	{ enum { Size = 1 }; };
+	template<> struct FormatTraits<SampleFormatUInt8>	{ enum { Size = 1 }; };
+	template<> struct FormatTraits<SampleFormatInt16>	{ enum { Size = 2 }; };
+	template<> struct FormatTraits<SampleFormatInt24>	{ enum { Size = 3 }; };
+	template<> struct FormatTraits<SampleFormatInt32>	{ enum { Size = 4 }; };
+	template<> struct FormatTraits<SampleFormatFloat32>	{ enum { Size = 4 }; };
+
+	template<typename T> T load(const uint8_t* _src)
+	{
+		T value;
+		::memcpy(&value, _src, sizeof(T));
+		return value;
+	}
+
+	// scalar conversion, used for single samples and for the remainder that does not fill a full SIMD register
+
+	template<SampleFormat F> float scalarValue(const uint8_t* _src);
+
+	template<> float scalarValue<SampleFormatInt8>(const uint8_t* _src)
+	{
+		return static_cast<float>(static_cast<int8_t>(_src[0])) * g_scaleInt8;
+	}
+
+	template<> float scalarValue<SampleFormatUInt8>(const uint8_t* _src)
+	{
+		return static_cast<float>(static_cast<int>(_src[0]) - 128) * g_scaleInt8;
+	}
+
+	template<> float scalarValue<SampleFormatInt16>(const uint8_t* _src)
+	{
+		return static_cast<float>(load<int16_t>(_src)) * g_scaleInt16;
+	}
+
+	template<> float scalarValue<SampleFormatInt24>(const uint8_t* _src)
+	{
+		// move to the upper 24 bits, shift back to fix the sign
+		const auto value = static_cast<int32_t>(static_cast<uint32_t>(_src[0]) << 8 | static_cast<uint32_t>(_src[1]) << 16 | static_cast<uint32_t>(_src[2]) << 24) >> 8;
+		return static_cast<float>(value) * g_scaleInt24;
+	}
+
+	template<> float scalarValue<SampleFormatInt32>(const uint8_t* _src)
+	{
+		return static_cast<float>(load<int32_t>(_src)) * g_scaleInt32;
+	}
+
+	template<> float scalarValue<SampleFormatFloat32>(const uint8_t* _src)
+	{
+		return load<float>(_src);
+	}
+
+#if defined(AS_SIMD_SSE2)
+	inline void storeInt32AsFloat(float* _dst, const __m128i _value, const __m128 _scale)
+	{
+		_mm_storeu_ps(_dst, _mm_mul_ps(_mm_cvtepi32_ps(_value), _scale));
+	}
+
+	inline void storeInt16AsFloat(float* _dst, const __m128i _value, const __m128 _scale)
+	{
+		// sign extend by moving to the upper half and shifting back
+		storeInt32AsFloat(_dst, _mm_srai_epi32(_mm_unpacklo_epi16(_value, _value), 16), _scale);
+		storeInt32AsFloat(_dst + 4, _mm_srai_epi32(_mm_unpackhi_epi16(_value, _value), 16), _scale);
+	}
+#endif
+
+#if defined(AS_SIMD_AVX2)
+	inline void storeInt32AsFloat(float* _dst, const __m256i _value, const __m256 _scale)
+	{
+		_mm256_storeu_ps(_dst, _mm256_mul_ps(_mm256_cvtepi32_ps(_value), _scale));
+	}
+#endif
+
+#if defined(AS_SIMD_NEON)
+	inline void storeInt16AsFloat(float* _dst, const int16x8_t _value, const float _scale)
+	{
+		vst1q_f32(_dst, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(_value))), _scale));
+		vst1q_f32(_dst + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(_value))), _scale));
+	}
+#endif
+
+	// SIMD conversion, returns the number of samples that have been converted
+	template<SampleFormat F> size_t convertSimd(float*, const uint8_t*, size_t)
+	{
+		return 0;
+	}
+
+	template<> size_t convertSimd<SampleFormatInt8>(float* _dst, const uint8_t* _src, const size_t _count)
+	{
+		size_t i = 0;
+#if defined(AS_SIMD_AVX2)
+		const auto scale = _mm256_set1_ps(g_scaleInt8);
+		for(; i + 8 <= _count; i += 8)
+			storeInt32AsFloat(_dst + i, _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(_src + i))), scale);
+#elif defined(AS_SIMD_SSE2)
+		const auto scale = _mm_set1_ps(g_scaleInt8);
+		for(; i + 16 <= _count; i += 16)
+		{
+			const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i));
+			storeInt16AsFloat(_dst + i, _mm_srai_epi16(_mm_unpacklo_epi8(x, x), 8), scale);
+			storeInt16AsFloat(_dst + i + 8, _mm_srai_epi16(_mm_unpackhi_epi8(x, x), 8), scale);
+		}
+#elif defined(AS_SIMD_NEON)
+		for(; i + 8 <= _count; i += 8)
+			storeInt16AsFloat(_dst + i, vmovl_s8(vld1_s8(reinterpret_cast<const int8_t*>(_src + i))), g_scaleInt8);
+#endif
+		return i;
+	}
+
+	template<> size_t convertSimd<SampleFormatInt16>(float* _dst, const uint8_t* _src, const size_t _count)
+	{
+		size_t i = 0;
+#if defined(AS_SIMD_AVX2)
+		const auto scale = _mm256_set1_ps(g_scaleInt16);
+		for(; i + 8 <= _count; i += 8)
+			storeInt32AsFloat(_dst + i, _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 2))), scale);
+#elif defined(AS_SIMD_SSE2)
+		const auto scale = _mm_set1_ps(g_scaleInt16);
+		for(; i + 8 <= _count; i += 8)
+			storeInt16AsFloat(_dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 2)), scale);
+#elif defined(AS_SIMD_NEON)
+		for(; i + 8 <= _count; i += 8)
+			storeInt16AsFloat(_dst + i, vld1q_s16(reinterpret_cast<const int16_t*>(_src + i * 2)), g_scaleInt16);
+#endif
+		return i;
+	}
+
+	template<> size_t convertSimd<SampleFormatInt24>(float* _dst, const uint8_t* _src, const size_t _count)
+	{
+		// packed 24 bit samples: spread 3 bytes into the upper 3 bytes of a 32 bit integer, then shift back to sign extend.
+		// The loads read a few bytes more than the samples being converted, stop early enough to stay within the buffer
+		size_t i = 0;
+#if defined(AS_SIMD_AVX2)
+		const auto scale = _mm256_set1_ps(g_scaleInt24);
+		const auto permute = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+		const auto shuffle = _mm256_setr_epi8(
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+			-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+		for(; (i + 8) * 3 + 8 <= _count * 3; i += 8)
+		{
+			auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + i * 3));
+			x = _mm256_permutevar8x32_epi32(x, permute);
+			x = _mm256_shuffle_epi8(x, shuffle);
+			storeInt32AsFloat(_dst + i, _mm256_srai_epi32(x, 8), scale);
+		}
+#elif defined(AS_SIMD_SSSE3)
+		const auto scale = _mm_set1_ps(g_scaleInt24);
+		const auto shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+
+		for(; (i + 4) * 3 + 4 <= _count * 3; i += 4)
+		{
+			const auto x = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 3)), shuffle);
+			storeInt32AsFloat(_dst + i, _mm_srai_epi32(x, 8), scale);
+		}
+#endif
+		(void)_dst; (void)_src; (void)_count;
+		return i;
+	}
+
+	template<> size_t convertSimd<SampleFormatInt32>(float* _dst, const uint8_t* _src, const size_t _count)
+	{
+		size_t i = 0;
+#if defined(AS_SIMD_AVX2)
+		const auto scale = _mm256_set1_ps(g_scaleInt32);
+		for(; i + 8 <= _count; i += 8)
+			storeInt32AsFloat(_dst + i, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(_src + i * 4)), scale);
+#elif defined(AS_SIMD_SSE2)
+		const auto scale = _mm_set1_ps(g_scaleInt32);
+		for(; i + 4 <= _count; i += 4)
+			storeInt32AsFloat(_dst + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(_src + i * 4)), scale);
+#elif defined(AS_SIMD_NEON)
+		for(; i + 4 <= _count; i += 4)
+			vst1q_f32(_dst + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(reinterpret_cast<const int32_t*>(_src + i * 4))), g_scaleInt32));
+#endif
+		return i;
+	}
+
+	template<> size_t convertSimd<SampleFormatFloat32>(float* _dst, const uint8_t* _src, const size_t _count)
+	{
+		::memcpy(_dst, _src, _count * sizeof(float));
+		return _count;
+	}
+
+	float peakFloat(const float* _src, const size_t _count)
+	{
+		size_t i = 0;
+		float result = 0.0f;
+
+#if defined(AS_SIMD_AVX2)
+		const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		auto acc = _mm256_setzero_ps();
+		for(; i + 8 <= _count; i += 8)
+			acc = _mm256_max_ps(acc, _mm256_and_ps(_mm256_loadu_ps(_src + i), absMask));
+		float temp[8];
+		_mm256_storeu_ps(temp, acc);
+		for(auto v : temp)
+			result = std::max(result, v);
+#elif defined(AS_SIMD_SSE2)
+		const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		auto acc = _mm_setzero_ps();
+		for(; i + 4 <= _count; i += 4)
+			acc = _mm_max_ps(acc, _mm_and_ps(_mm_loadu_ps(_src + i), absMask));
+		float temp[4];
+		_mm_storeu_ps(temp, acc);
+		for(auto v : temp)
+			result = std::max(result, v);
+#elif defined(AS_SIMD_NEON)
+		auto acc = vdupq_n_f32(0.0f);
+		for(; i + 4 <= _count; i += 4)
+			acc = vmaxq_f32(acc, vabsq_f32(vld1q_f32(_src + i)));
+		float temp[4];
+		vst1q_f32(temp, acc);
+		for(auto v : temp)
+			result = std::max(result, v);
+#endif
+		for(; i<_count; ++i)
+			result = std::max(result, std::abs(_src[i]));
+
+		return result;
+	}
+
+	float sumOfSquaresFloat(const float* _src, const size_t _count)
+	{
+		size_t i = 0;
+		float result = 0.0f;
+
+#if defined(AS_SIMD_AVX2)
+		auto acc = _mm256_setzero_ps();
+		for(; i + 8 <= _count; i += 8)
+		{
+			const auto x = _mm256_loadu_ps(_src + i);
+			acc = _mm256_add_ps(acc, _mm256_mul_ps(x, x));
+		}
+		float temp[8];
+		_mm256_storeu_ps(temp, acc);
+		for(auto v : temp)
+			result += v;
+#elif defined(AS_SIMD_SSE2)
+		auto acc = _mm_setzero_ps();
+		for(; i + 4 <= _count; i += 4)
+		{
+			const auto x = _mm_loadu_ps(_src + i);
+			acc = _mm_add_ps(acc, _mm_mul_ps(x, x));
+		}
+		float temp[4];
+		_mm_storeu_ps(temp, acc);
+		for(auto v : temp)
+			result += v;
+#elif defined(AS_SIMD_NEON)
+		auto acc = vdupq_n_f32(0.0f);
+		for(; i + 4 <= _count; i += 4)
+		{
+			const auto x = vld1q_f32(_src + i);
+			acc = vmlaq_f32(acc, x, x);
+		}
+		float temp[4];
+		vst1q_f32(temp, acc);
+		for(auto v : temp)
+			result += v;
+#endif
+		for(; i<_count; ++i)
+			result += _src[i] * _src[i];
+
+		return result;
+	}
+
+	// The SIMD loops only locate the group of samples that contains a match, the exact position is determined by the scalar loop.
+	// Both return _count if no sample is above the threshold
+
+	size_t firstAboveFloat(const float* _src, const size_t _count, const float _threshold)
+	{
+		size_t i = 0;
+
+#if defined(AS_SIMD_AVX2)
+		const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const auto threshold = _mm256_set1_ps(_threshold);
+		for(; i + 8 <= _count; i += 8)
+		{
+			if(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(_src + i), absMask), threshold, _CMP_GE_OQ)))
+				break;
+		}
+#elif defined(AS_SIMD_SSE2)
+		const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const auto threshold = _mm_set1_ps(_threshold);
+		for(; i + 4 <= _count; i += 4)
+		{
+			if(_mm_movemask_ps(_mm_cmpge_ps(_mm_and_ps(_mm_loadu_ps(_src + i), absMask), threshold)))
+				break;
+		}
+#elif defined(AS_SIMD_NEON)
+		const auto threshold = vdupq_n_f32(_threshold);
+		for(; i + 4 <= _count; i += 4)
+		{
+			const auto mask = vcageq_f32(vld1q_f32(_src + i), threshold);
+			const auto any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+			if(vget_lane_u32(vpmax_u32(any, any), 0))
+				break;
+		}
+#endif
+		for(; i<_count; ++i)
+		{
+			if(std::abs(_src[i]) >= _threshold)
+				return i;
+		}
+		return _count;
+	}
+
+	size_t lastAboveFloat(const float* _src, const size_t _count, const float _threshold)
+	{
+		size_t i = _count;
+
+#if defined(AS_SIMD_AVX2)
+		const auto absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const auto threshold = _mm256_set1_ps(_threshold);
+		for(; i >= 8; i -= 8)
+		{
+			if(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(_mm256_loadu_ps(_src + i - 8), absMask), threshold, _CMP_GE_OQ)))
+				break;
+		}
+#elif defined(AS_SIMD_SSE2)
+		const auto absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const auto threshold = _mm_set1_ps(_threshold);
+		for(; i >= 4; i -= 4)
+		{
+			if(_mm_movemask_ps(_mm_cmpge_ps(_mm_and_ps(_mm_loadu_ps(_src + i - 4), absMask), threshold)))
+				break;
+		}
+#elif defined(AS_SIMD_NEON)
+		const auto threshold = vdupq_n_f32(_threshold);
+		for(; i >= 4; i -= 4)
+		{
+			const auto mask = vcageq_f32(vld1q_f32(_src + i - 4), threshold);
+			const auto any = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+			if(vget_lane_u32(vpmax_u32(any, any), 0))
+				break;
+		}
+#endif
+		for(; i>0; --i)
+		{
+			if(std::abs(_src[i-1]) >= _threshold)
+				return i-1;
+		}
+		return _count;
+	}
+}
+
+float SampleConverter::toFloat(const SampleFormat _format, const void* _sample)
+{
+	const auto* src = static_cast<const uint8_t*>(_sample);
+
+	switch (_format)
+	{
+	case SampleFormatInt8:		return scalarValue<SampleFormatInt8>(src);
+	case SampleFormatUInt8:		return scalarValue<SampleFormatUInt8>(src);
+	case SampleFormatInt16:		return scalarValue<SampleFormatInt16>(src);
+	case SampleFormatInt24:		return scalarValue<SampleFormatInt24>(src);
+	case SampleFormatInt32:		return scalarValue<SampleFormatInt32>(src);
+	case SampleFormatFloat32:	return scalarValue<SampleFormatFloat32>(src);
+	}
+	return 0.0f;
+}
+
+template<SampleFormat F> void SampleConverter::toFloat(float* _dst, const void* _src, const size_t _sampleCount)
+{
+	const auto* src = static_cast<const uint8_t*>(_src);
+
+	for(auto i = convertSimd<F>(_dst, src, _sampleCount); i<_sampleCount; ++i)
+		_dst[i] = scalarValue<F>(src + i * FormatTraits<F>::Size);
+}
+
+template<SampleFormat F> float SampleConverter::peak(const void* _src, const size_t _sampleCount)
+{
+	const auto* src = static_cast<const uint8_t*>(_src);
+
+	if(F == SampleFormatFloat32)
+		return peakFloat(reinterpret_cast<const float*>(src), _sampleCount);
+
+	float buffer[g_blockSize];
+	float result = 0.0f;
+
+	for(size_t i=0; i<_sampleCount; i += g_blockSize)
+	{
+		const auto count = std::min(g_blockSize, _sampleCount - i);
+		toFloat<F>(buffer, src + i * FormatTraits<F>::Size, count);
+		result = std::max(result, peakFloat(buffer, count));
+	}
+
+	return result;
+}
+
+template<SampleFormat F> double SampleConverter::sumOfSquares(const void* _src, const size_t _sampleCount)
+{
+	const auto* src = static_cast<const uint8_t*>(_src);
+
+	float buffer[g_blockSize];
+	double result = 0.0;
+
+	// accumulate in blocks to keep the float sums short enough to not lose precision
+	for(size_t i=0; i<_sampleCount; i += g_blockSize)
+	{
+		const auto count = std::min(g_blockSize, _sampleCount - i);
+
+		if(F == SampleFormatFloat32)
+		{
+			result += sumOfSquaresFloat(reinterpret_cast<const float*>(src) + i, count);
+		}
+		else
+		{
+			toFloat<F>(buffer, src + i * FormatTraits<F>::Size, count);
+			result += sumOfSquaresFloat(buffer, count);
+		}
+	}
+
+	return result;
+}
+
+template<SampleFormat F> bool SampleConverter::findFirstAbove(const void* _src, const size_t _sampleCount, const float _threshold, size_t& _index)
+{
+	const auto* src = static_cast<const uint8_t*>(_src);
+
+	if(F == SampleFormatFloat32)
+	{
+		const auto index = firstAboveFloat(reinterpret_cast<const float*>(src), _sampleCount, _threshold);
+		if(index == _sampleCount)
+			return false;
+		_index = index;
+		return true;
+	}
+
+	float buffer[g_blockSize];
+
+	for(size_t i=0; i<_sampleCount; i += g_blockSize)
+	{
+		const auto count = std::min(g_blockSize, _sampleCount - i);
+		toFloat<F>(buffer, src + i * FormatTraits<F>::Size, count);
+
+		const auto index = firstAboveFloat(buffer, count, _threshold);
+		if(index < count)
+		{
+			_index = i + index;
+			return true;
+		}
+	}
+	return false;
+}
+
+template<SampleFormat F> bool SampleConverter::findLastAbove(const void* _src, const size_t _sampleCount, const float _threshold, size_t& _index)
+{
+	const auto* src = static_cast<const uint8_t*>(_src);
+
+	if(F == SampleFormatFloat32)
+	{
+		const auto index = lastAboveFloat(reinterpret_cast<const float*>(src), _sampleCount, _threshold);
+		if(index == _sampleCount)
+			return false;
+		_index = index;
+		return true;
+	}
+
+	float buffer[g_blockSize];
+
+	// walk the blocks backwards, the last one may be partial
+	for(size_t end = _sampleCount; end > 0;)
+	{
+		const auto count = (end - 1) % g_blockSize + 1;
+		const auto i = end - count;
+
+		toFloat<F>(buffer, src + i * FormatTraits<F>::Size, count);
+
+		const auto index = lastAboveFloat(buffer, count, _threshold);
+		if(index < count)
+		{
+			_index = i + index;
+			return true;
+		}
+		end = i;
+	}
+	return false;
+}
+
+#define AS_SAMPLECONVERTER_DISPATCH(FUNC, ...)													\
+	switch (_format)																			\
+	{																							\
+	case SampleFormatInt8:		return FUNC<SampleFormatInt8>(__VA_ARGS__);					\
+	case SampleFormatUInt8:		return FUNC<SampleFormatUInt8>(__VA_ARGS__);				\
+	case SampleFormatInt16:		return FUNC<SampleFormatInt16>(__VA_ARGS__);				\
+	case SampleFormatInt24:		return FUNC<SampleFormatInt24>(__VA_ARGS__);				\
+	case SampleFormatInt32:		return FUNC<SampleFormatInt32>(__VA_ARGS__);				\
+	case SampleFormatFloat32:	return FUNC<SampleFormatFloat32>(__VA_ARGS__);				\
+	}
+
+void SampleConverter::toFloat(const SampleFormat _format, float* _dst, const void* _src, const size_t _sampleCount)
+{
+	AS_SAMPLECONVERTER_DISPATCH(toFloat, _dst, _src, _sampleCount)
+}
+
+float SampleConverter::peak(const SampleFormat _format, const void* _src, const size_t _sampleCount)
+{
+	AS_SAMPLECONVERTER_DISPATCH(peak, _src, _sampleCount)
+	return 0.0f;
+}
+
+double SampleConverter::sumOfSquares(const SampleFormat _format, const void* _src, const size_t _sampleCount)
+{
+	AS_SAMPLECONVERTER_DISPATCH(sumOfSquares, _src, _sampleCount)
+	return 0.0;
+}
+
+bool SampleConverter::findFirstAbove(const SampleFormat _format, const void* _src, const size_t _sampleCount, const float _threshold, size_t& _index)
+{
+	AS_SAMPLECONVERTER_DISPATCH(findFirstAbove, _src, _sampleCount, _threshold, _index)
+	return false;
+}
+
+bool SampleConverter::findLastAbove(const SampleFormat _format, const void* _src, const size_t _sampleCount, const float _threshold, size_t& _index)
+{
+	AS_SAMPLECONVERTER_DISPATCH(findLastAbove, _src, _sampleCount, _threshold, _index)
+	return false;
+}
+
+#define AS_SAMPLECONVERTER_INSTANTIATE(F)																\
+	template void SampleConverter::toFloat<F>(float*, const void*, size_t);								\
+	template float SampleConverter::peak<F>(const void*, size_t);										\
+	template double SampleConverter::sumOfSquares<F>(const void*, size_t);								\
+	template bool SampleConverter::findFirstAbove<F>(const void*, size_t, float, size_t&);				\
+	template bool SampleConverter::findLastAbove<F>(const void*, size_t, float, size_t&);
+
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatInt8)
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatUInt8)
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatInt16)
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatInt24)
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatInt32)
+AS_SAMPLECONVERTER_INSTANTIATE(SampleFormatFloat32)
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace asLib
+{
+	enum SampleFormat
+	{
+		SampleFormatInt8,
+		SampleFormatUInt8,
+		SampleFormatInt16,
+		SampleFormatInt24,
+		SampleFormatInt32,
+		SampleFormatFloat32,
+	};
+
+	// maps a PortAudio sample format (paInt16, ...), throws if the format is not supported
+	SampleFormat toSampleFormat(unsigned long _portAudioFormat);
+	size_t getSampleSize(SampleFormat _format);
+
+	// Block-wise conversion and analysis of interleaved audio data, specialized for each sample format at compile time.
+	// Uses SSE2/SSSE3/AVX2 or NEON depending on the target architecture, falls back to scalar code otherwise
+	class SampleConverter
+	{
+	public:
+		// single sample
+		static float toFloat(SampleFormat _format, const void* _sample);
+
+		// converts _sampleCount samples to float in range [-1,1)
+		template<SampleFormat F> static void toFloat(float* _dst, const void* _src, size_t _sampleCount);
+		static void toFloat(SampleFormat _format, float* _dst, const void* _src, size_t _sampleCount);
+
+		// largest absolute sample value
+		template<SampleFormat F> static float peak(const void* _src, size_t _sampleCount);
+		static float peak(SampleFormat _format, const void* _src, size_t _sampleCount);
+
+		// sum of all squared sample values, used to calculate the RMS
+		template<SampleFormat F> static double sumOfSquares(const void* _src, size_t _sampleCount);
+		static double sumOfSquares(SampleFormat _format, const void* _src, size_t _sampleCount);
+
+		// index of the first/last sample with an absolute value >= _threshold. Returns false if there is none
+		template<SampleFormat F> static bool findFirstAbove(const void* _src, size_t _sampleCount, float _threshold, size_t& _index);
+		static bool findFirstAbove(SampleFormat _format, const void* _src, size_t _sampleCount, float _threshold, size_t& _index);
+
+		template<SampleFormat F> static bool findLastAbove(const void* _src, size_t _sampleCount, float _threshold, size_t& _index);
+		static bool findLastAbove(SampleFormat _format, const void* _src, size_t _sampleCount, float _threshold, size_t& _index);
+	};
+}
@@ -0,0 +1,108 @@
+#include "session.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <sstream>
+
+#include "autosampler.h"
+#include "error.h"
+#include "fileWriter.h"
+#include "sessionJournal.h"
+
+#include "../asBase/logging.h"
+#include "../asBase/threadPool.h"
+
+namespace asLib
+{
+Session::Session(const Config& _config)
+{
+	const auto deviceCount = std::max(static_cast<size_t>(1), _config.devices.size());
+
+	// writer threads and queue are per device, the pool is shared so that idle threads pick up the work of busy devices
+	m_writerPool.reset(new asBase::ThreadPool(static_cast<size_t>(_config.writerThreads) * deviceCount, static_cast<size_t>(_config.writerQueueSize) * deviceCount));
+
+	// one journal for all devices, their files are distinguished by the {device} placeholder
+	std::shared_ptr<SessionJournal> journal;
+
+	if(!_config.journalFile.empty())
+		journal.reset(new SessionJournal(_config.journalFile));
+
+	for(size_t i=0; i<deviceCount; ++i)
+	{
+		if(deviceCount > 1)
+			LOG("Opening device " << i << ": audio input '" << _config.devices[i].inputDevice << "', MIDI output '" << _config.devices[i].midiOutputDevice << "'");
+
+		m_samplers.emplace_back(new AutoSampler(createDeviceConfig(_config, i), m_writerPool, journal));
+	}
+}
+
+Session::~Session()
+{
+	m_samplers.clear();
+}
+
+void Session::run()
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	// let all devices finish even if one of them fails
+	std::exception_ptr error;
+
+	for(auto& sampler : m_samplers)
+	{
+		try
+		{
+			sampler->run();
+		}
+		catch(...)
+		{
+			if(!error)
+				error = std::current_exception();
+		}
+	}
+
+	// the writers are shared by all devices, no more files are queued once every device has finished recording
+	try
+	{
+		m_writerPool->waitIdle();
+	}
+	catch(...)
+	{
+		if(!error)
+			error = std::current_exception();
+	}
+
+	const auto failedWrites = FileWriter::waitAsync();
+
+	if(m_samplers.size() > 1)
+	{
+		const auto seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+		LOG("Sampled " << m_samplers.size() << " devices in " << seconds << " seconds");
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+
+	if(failedWrites)
+	{
+		std::stringstream ss; ss << failedWrites << " files could not be written";
+		throw Error(ErrFileIO, ss);
+	}
+}
+
+Config Session::createDeviceConfig(const Config& _config, const size_t _deviceIndex)
+{
+	auto config = _config;
+
+	if(_config.devices.empty())
+		return config;
+
+	config.inputDevice = _config.devices[_deviceIndex].inputDevice;
+	config.midiOutputDevice = _config.devices[_deviceIndex].midiOutputDevice;
+	config.devices.clear();
+	config.deviceIndex = static_cast<int>(_deviceIndex);
+
+	return config;
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "config.h"
+
+namespace asBase
+{
+	class ThreadPool;
+}
+
+namespace asLib
+{
+	class AutoSampler;
+
+	// Samples all devices of a rack in parallel. Every device has its own state machine and voices, recorded takes of
+	// all devices are written by one shared pool of writer threads
+	class Session
+	{
+	public:
+		explicit Session(const Config& _config);
+		Session(const Session&) = delete;
+		~Session();
+
+		void run();
+
+		static Config createDeviceConfig(const Config& _config, size_t _deviceIndex);
+
+		Session& operator = (const Session&) = delete;
+
+	private:
+		std::shared_ptr<asBase::ThreadPool> m_writerPool;
+		std::vector<std::unique_ptr<AutoSampler>> m_samplers;	// destroyed first, writer jobs do not depend on them
+	};
+}
@@ -0,0 +1,177 @@
+#include "sessionJournal.h"
+
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <vector>
+
+#include "error.h"
+#include "fileWriter.h"
+
+#include "../asBase/logging.h"
+
+namespace asLib
+{
+namespace
+{
+	constexpr size_t g_readBufferSize = 1024 * 1024;
+
+	std::array<uint32_t, 256> createCrcTable()
+	{
+		std::array<uint32_t, 256> table{};
+
+		for(uint32_t i=0; i<256; ++i)
+		{
+			auto crc = i;
+			for(int b=0; b<8; ++b)
+				crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320u : 0u);
+			table[i] = crc;
+		}
+
+		return table;
+	}
+}
+
+SessionJournal::SessionJournal(const std::string& _filename) : m_filename(_filename)
+{
+	const auto incompleteLine = load();
+
+	m_handle = fopen(m_filename.c_str(), "ab");
+
+	if(!m_handle)
+		throw Error(ErrFileIO, "Failed to open session journal " + m_filename);
+
+	// terminate a line that was interrupted by a crash, it is ignored when the journal is loaded the next time
+	if(incompleteLine)
+		fputc('\n', m_handle);
+
+	if(!m_completed.empty())
+		LOG("Session journal " << m_filename << " contains " << m_completed.size() << " completed takes");
+}
+
+SessionJournal::~SessionJournal()
+{
+	if(m_handle)
+		fclose(m_handle);
+}
+
+bool SessionJournal::contains(const std::string& _filename) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_completed.find(_filename) != m_completed.end();
+}
+
+size_t SessionJournal::size() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_completed.size();
+}
+
+void SessionJournal::add(const Entry& _entry)
+{
+	std::stringstream ss;
+	ss << _entry.note << ' ' << _entry.velocity << ' ' << _entry.program << ' ' << _entry.channel << ' ' << _entry.size << ' ' << std::hex << _entry.checksum << ' ' << _entry.filename << '\n';
+
+	const auto line = ss.str();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// one write per line, a crash can only truncate the last line. Synced, the file it refers to is on disk already
+	if(fwrite(line.c_str(), 1, line.size(), m_handle) != line.size() || !FileWriter::syncFile(m_handle))
+	{
+		LOG_ERROR("Failed to write to session journal " << m_filename);
+		return;
+	}
+
+	m_completed.insert(_entry.filename);
+}
+
+uint32_t SessionJournal::crc32(const void* _data, const size_t _size, uint32_t _crc/* = 0*/)
+{
+	static const auto table = createCrcTable();
+
+	const auto* data = static_cast<const uint8_t*>(_data);
+
+	_crc = ~_crc;
+
+	for(size_t i=0; i<_size; ++i)
+		_crc = (_crc >> 8) ^ table[(_crc ^ data[i]) & 0xff];
+
+	return ~_crc;
+}
+
+bool SessionJournal::crc32(const std::string& _filename, const uint64_t _offset, uint64_t _size, uint32_t& _crc)
+{
+	FILE* handle = fopen(_filename.c_str(), "rb");
+
+	if(!handle)
+		return false;
+
+	std::vector<uint8_t> buffer(static_cast<size_t>(std::min(static_cast<uint64_t>(g_readBufferSize), _size)));
+
+	_crc = 0;
+
+	auto res = fseek(handle, static_cast<long>(_offset), SEEK_SET) == 0;
+
+	while(res && _size)
+	{
+		const auto size = static_cast<size_t>(std::min(static_cast<uint64_t>(buffer.size()), _size));
+
+		res = fread(buffer.data(), 1, size, handle) == size;
+
+		if(res)
+			_crc = crc32(buffer.data(), size, _crc);
+
+		_size -= size;
+	}
+
+	fclose(handle);
+
+	return res;
+}
+
+bool SessionJournal::load()
+{
+	FILE* handle = fopen(m_filename.c_str(), "rb");
+
+	// a new session
+	if(!handle)
+		return false;
+
+	std::string content;
+	std::vector<char> buffer(g_readBufferSize);
+
+	for(size_t size; (size = fread(buffer.data(), 1, buffer.size(), handle)) > 0;)
+		content.append(buffer.data(), size);
+
+	fclose(handle);
+
+	size_t lineCount = 0;
+
+	for(size_t pos = 0; pos < content.size();)
+	{
+		const auto end = content.find('\n', pos);
+
+		// the last line is incomplete if the session crashed while it was written
+		if(end == std::string::npos)
+			break;
+
+		std::stringstream ss(content.substr(pos, end - pos));
+		pos = end + 1;
+		++lineCount;
+
+		Entry entry;
+		ss >> entry.note >> entry.velocity >> entry.program >> entry.channel >> entry.size >> std::hex >> entry.checksum;
+
+		if(!ss || ss.get() != ' ' || !std::getline(ss, entry.filename) || entry.filename.empty())
+		{
+			LOG("Ignoring invalid line " << lineCount << " of session journal " << m_filename);
+			continue;
+		}
+
+		m_completed.insert(entry.filename);
+	}
+
+	return !content.empty() && content.back() != '\n';
+}
+}
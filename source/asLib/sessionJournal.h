@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace asLib
+{
+	// Append-only record of the completed takes of a session. A session that is started again with the same journal skips
+	// them without accessing the file system. Takes that were interrupted by a crash or a power loss are not recorded and are
+	// sampled again.
+	// One line per take: note velocity program channel size checksum filename
+	class SessionJournal
+	{
+	public:
+		struct Entry
+		{
+			int note = -1;
+			int velocity = -1;
+			int program = -1;
+			int channel = 0;
+			uint64_t size = 0;			// bytes of audio data, 0 if the take was silent and no file has been written
+			uint32_t checksum = 0;		// CRC-32 of the audio data
+			std::string filename;
+		};
+
+		// loads the entries of an existing journal and opens it for appending, throws if that fails
+		explicit SessionJournal(const std::string& _filename);
+		SessionJournal(const SessionJournal&) = delete;
+		~SessionJournal();
+
+		bool contains(const std::string& _filename) const;
+		size_t size() const;
+
+		// appends the entry and flushes the journal, thread safe. Logs an error if the journal cannot be written
+		void add(const Entry& _entry);
+
+		static uint32_t crc32(const void* _data, size_t _size, uint32_t _crc = 0);
+
+		// CRC-32 of _size bytes at _offset of an existing file
+		static bool crc32(const std::string& _filename, uint64_t _offset, uint64_t _size, uint32_t& _crc);
+
+		SessionJournal& operator = (const SessionJournal&) = delete;
+
+	private:
+		// returns true if the last line is incomplete
+		bool load();
+
+		const std::string m_filename;
+		FILE* m_handle = nullptr;
+
+		mutable std::mutex m_mutex;
+		std::unordered_set<std::string> m_completed;
+	};
+}
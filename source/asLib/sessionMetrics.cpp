@@ -0,0 +1,231 @@
+#include "sessionMetrics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+#include "../asBase/logging.h"
+
+namespace asLib
+{
+namespace
+{
+	const double g_bucketLimits[CallbackMetrics::BucketCount] = { 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 0.75, 1.0, std::numeric_limits<double>::infinity() };
+
+	std::string escapeJson(const std::string& _text)
+	{
+		std::string result;
+		result.reserve(_text.size());
+
+		for(const auto c : _text)
+		{
+			switch(c)
+			{
+			case '"':	result += "\\\"";	break;
+			case '\\':	result += "\\\\";	break;
+			case '\n':	result += "\\n";	break;
+			case '\r':	result += "\\r";	break;
+			case '\t':	result += "\\t";	break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					const char* hex = "0123456789abcdef";
+					result += "\\u00";
+					result += hex[(c >> 4) & 0xf];
+					result += hex[c & 0xf];
+				}
+				else
+				{
+					result += c;
+				}
+			}
+		}
+		return result;
+	}
+
+	void writeStatistics(std::ostream& _out, const SessionMetrics::Statistics& _stats, const double _scale)
+	{
+		_out << "{ \"count\": " << _stats.count << ", \"min\": " << _stats.min * _scale << ", \"mean\": " << _stats.getMean() * _scale << ", \"max\": " << _stats.max * _scale << " }";
+	}
+}
+
+CallbackMetrics::CallbackMetrics()
+{
+	for(auto& bucket : m_buckets)
+		bucket.store(0, std::memory_order_relaxed);
+}
+
+void CallbackMetrics::add(const double _duration, const double _period, const bool _inputOverflow)
+{
+	const auto load = _period > 0.0 ? _duration / _period : 0.0;
+
+	size_t bucket = 0;
+	while(load > g_bucketLimits[bucket])
+		++bucket;
+
+	m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+	m_callbackCount.fetch_add(1, std::memory_order_relaxed);
+
+	if(_inputOverflow)
+		m_inputOverflowCount.fetch_add(1, std::memory_order_relaxed);
+
+	// single writer, no need for a compare-exchange loop
+	const auto ppm = static_cast<uint64_t>(load * 1000000.0);
+	if(ppm > m_maxLoadPpm.load(std::memory_order_relaxed))
+		m_maxLoadPpm.store(ppm, std::memory_order_relaxed);
+}
+
+double CallbackMetrics::getMaxLoad() const
+{
+	return static_cast<double>(m_maxLoadPpm.load(std::memory_order_relaxed)) / 1000000.0;
+}
+
+double CallbackMetrics::getBucketLimit(const size_t _index)
+{
+	return g_bucketLimits[_index];
+}
+
+void SessionMetrics::Statistics::add(const double _value)
+{
+	if(!count || _value < min)
+		min = _value;
+	if(!count || _value > max)
+		max = _value;
+
+	sum += _value;
+	++count;
+}
+
+SessionMetrics::SessionMetrics(const CallbackMetrics* _callbacks, const size_t _writerQueueSize) : m_callbacks(_callbacks), m_writerQueueHistogram(_writerQueueSize + 1, 0)
+{
+}
+
+void SessionMetrics::addMidiEvent(const double _sendDuration, const bool _scheduled, const double _ahead)
+{
+	m_midiSendDuration.add(_sendDuration);
+
+	if(!_scheduled)
+		return;
+
+	m_midiAhead.add(_ahead);
+
+	if(_ahead < 0.0)
+		++m_lateMidiEventCount;
+}
+
+void SessionMetrics::addTake(const Take& _take, const std::string& _filename, const size_t _writerQueueDepth, const double _cpuLoad)
+{
+	++m_takeCount;
+
+	if(_take.retake)
+		++m_retakeCount;
+
+	if(_take.bufferOverflows || _take.deviceOverflows || _take.clipped)
+	{
+		m_bufferOverflowCount += _take.bufferOverflows;
+		m_failedTakes.push_back(_take);
+		m_failedTakes.back().filename = _filename;
+	}
+
+	m_writerQueueDepth.add(static_cast<double>(_writerQueueDepth));
+	++m_writerQueueHistogram[std::min(_writerQueueDepth, m_writerQueueHistogram.size() - 1)];
+
+	if(_cpuLoad > 0.0)
+		m_cpuLoad.add(_cpuLoad);
+}
+
+void SessionMetrics::log() const
+{
+	if(m_callbacks)
+		LOG("Metrics: " << m_callbacks->getCallbackCount() << " callbacks, max load " << m_callbacks->getMaxLoad() * 100.0 << "%, " << m_callbacks->getInputOverflowCount() << " device overflows, " << m_bufferOverflowCount << " buffer overflows, " << m_retakeCount << " retakes, writer queue " << m_writerQueueDepth.getMean() << " avg " << m_writerQueueDepth.max << " max, MIDI send " << m_midiSendDuration.max * 1000000.0 << " us max, " << m_lateMidiEventCount << " late")
+	else
+		LOG("Metrics: " << m_bufferOverflowCount << " buffer overflows, " << m_retakeCount << " retakes, writer queue " << m_writerQueueDepth.getMean() << " avg " << m_writerQueueDepth.max << " max, MIDI send " << m_midiSendDuration.max * 1000000.0 << " us max, " << m_lateMidiEventCount << " late")
+}
+
+bool SessionMetrics::writeJson(const std::string& _filename, const double _seconds, const float _samplerate, const int _blockSize) const
+{
+	std::ofstream out(_filename, std::ios::trunc);
+
+	if(!out.is_open())
+	{
+		LOG_ERROR("Failed to create metrics file " << _filename);
+		return false;
+	}
+
+	out << "{\n";
+	out << "\t\"seconds\": " << _seconds << ",\n";
+	out << "\t\"samplerate\": " << _samplerate << ",\n";
+	out << "\t\"blockSize\": " << _blockSize << ",\n";
+	out << "\t\"takes\": " << m_takeCount << ",\n";
+	out << "\t\"retakes\": " << m_retakeCount << ",\n";
+
+	if(m_callbacks)
+	{
+		out << "\t\"callbacks\": {\n";
+		out << "\t\t\"count\": " << m_callbacks->getCallbackCount() << ",\n";
+		out << "\t\t\"maxLoad\": " << m_callbacks->getMaxLoad() << ",\n";
+		out << "\t\t\"inputOverflows\": " << m_callbacks->getInputOverflowCount() << ",\n";
+		out << "\t\t\"loadHistogram\": [";
+
+		for(size_t i=0; i<CallbackMetrics::BucketCount; ++i)
+		{
+			const auto limit = CallbackMetrics::getBucketLimit(i);
+
+			out << (i ? ", " : " ") << "{ \"maxLoad\": ";
+			if(limit == std::numeric_limits<double>::infinity())
+				out << "null";
+			else
+				out << limit;
+			out << ", \"count\": " << m_callbacks->getBucket(i) << " }";
+		}
+
+		out << " ]\n";
+		out << "\t},\n";
+	}
+
+	out << "\t\"cpuLoad\": ";					writeStatistics(out, m_cpuLoad, 1.0);					out << ",\n";
+	out << "\t\"bufferOverflows\": " << m_bufferOverflowCount << ",\n";
+
+	out << "\t\"midi\": {\n";
+	out << "\t\t\"sendMicroseconds\": ";		writeStatistics(out, m_midiSendDuration, 1000000.0);	out << ",\n";
+	out << "\t\t\"aheadMilliseconds\": ";		writeStatistics(out, m_midiAhead, 1000.0);				out << ",\n";
+	out << "\t\t\"lateEvents\": " << m_lateMidiEventCount << "\n";
+	out << "\t},\n";
+
+	out << "\t\"writerQueue\": {\n";
+	out << "\t\t\"capacity\": " << m_writerQueueHistogram.size() - 1 << ",\n";
+	out << "\t\t\"depth\": ";					writeStatistics(out, m_writerQueueDepth, 1.0);			out << ",\n";
+	out << "\t\t\"histogram\": [";
+
+	for(size_t i=0; i<m_writerQueueHistogram.size(); ++i)
+		out << (i ? ", " : " ") << m_writerQueueHistogram[i];
+
+	out << " ]\n";
+	out << "\t},\n";
+
+	out << "\t\"failedTakes\": [";
+
+	for(size_t i=0; i<m_failedTakes.size(); ++i)
+	{
+		const auto& take = m_failedTakes[i];
+
+		out << (i ? ",\n" : "\n") << "\t\t{ \"filename\": \"" << escapeJson(take.filename) << "\", \"note\": " << take.note << ", \"velocity\": " << take.velocity << ", \"program\": " << take.program
+			<< ", \"bufferOverflows\": " << take.bufferOverflows << ", \"deviceOverflows\": " << take.deviceOverflows
+			<< ", \"clipped\": " << (take.clipped ? "true" : "false") << ", \"retake\": " << (take.retake ? "true" : "false") << " }";
+	}
+
+	out << (m_failedTakes.empty() ? "]\n" : "\n\t]\n");
+	out << "}\n";
+
+	out.close();
+
+	if(out.fail())
+	{
+		LOG_ERROR("Failed to write metrics file " << _filename);
+		return false;
+	}
+
+	LOG("Metrics written to " << _filename);
+	return true;
+}
+}
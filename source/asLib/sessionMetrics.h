@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace asLib
+{
+	// Execution time of the audio callback relative to the duration of the block it processes. Updated by the real-time
+	// thread without locking, can be read from any thread
+	class CallbackMetrics
+	{
+	public:
+		static constexpr size_t BucketCount = 9;
+
+		CallbackMetrics();
+		CallbackMetrics(const CallbackMetrics&) = delete;
+
+		// _duration is the time spent in the callback, _period the length of the block, both in seconds
+		void add(double _duration, double _period, bool _inputOverflow);
+
+		uint64_t getCallbackCount() const		{ return m_callbackCount.load(std::memory_order_relaxed); }
+		uint64_t getInputOverflowCount() const	{ return m_inputOverflowCount.load(std::memory_order_relaxed); }
+		uint64_t getBucket(size_t _index) const	{ return m_buckets[_index].load(std::memory_order_relaxed); }
+		double getMaxLoad() const;
+
+		// upper limit of a bucket as fraction of the block length, the last bucket holds callbacks that missed their deadline
+		static double getBucketLimit(size_t _index);
+
+		CallbackMetrics& operator = (const CallbackMetrics&) = delete;
+
+	private:
+		std::atomic<uint64_t> m_buckets[BucketCount];
+		std::atomic<uint64_t> m_callbackCount{0};
+		std::atomic<uint64_t> m_inputOverflowCount{0};
+		std::atomic<uint64_t> m_maxLoadPpm{0};
+	};
+
+	// Timing and overflow statistics of a recording session. Written as JSON once the session has finished and optionally
+	// logged after every take. Not thread safe, it is used by the capture thread only
+	class SessionMetrics
+	{
+	public:
+		struct Statistics
+		{
+			uint64_t count = 0;
+			double sum = 0.0;
+			double min = 0.0;
+			double max = 0.0;
+
+			void add(double _value);
+			double getMean() const	{ return count ? sum / static_cast<double>(count) : 0.0; }
+		};
+
+		struct Take
+		{
+			std::string filename;
+			int note;
+			int velocity;
+			int program;
+			size_t bufferOverflows;		// the capture thread did not keep up
+			uint64_t deviceOverflows;	// reported by the audio device
+			bool clipped;
+			bool retake;				// the take has been discarded and is recorded again
+		};
+
+		// the callback metrics are owned by the audio source, null if it does not have any
+		SessionMetrics(const CallbackMetrics* _callbacks, size_t _writerQueueSize);
+
+		// _sendDuration is the time spent sending the event. _ahead is the time between sending it and the time at which it is
+		// to be played, negative if it is late, for events that are scheduled only
+		void addMidiEvent(double _sendDuration, bool _scheduled, double _ahead);
+
+		// takes are listed only if they had overflows or clipped, _filename is only copied for those
+		void addTake(const Take& _take, const std::string& _filename, size_t _writerQueueDepth, double _cpuLoad);
+
+		void log() const;
+
+		// logs an error and returns false if the file cannot be written
+		bool writeJson(const std::string& _filename, double _seconds, float _samplerate, int _blockSize) const;
+
+	private:
+		const CallbackMetrics* m_callbacks;
+
+		size_t m_takeCount = 0;
+		size_t m_bufferOverflowCount = 0;
+		size_t m_retakeCount = 0;
+		std::vector<Take> m_failedTakes;
+
+		Statistics m_cpuLoad;
+
+		Statistics m_midiSendDuration;
+		Statistics m_midiAhead;
+		size_t m_lateMidiEventCount = 0;
+
+		Statistics m_writerQueueDepth;
+		std::vector<uint64_t> m_writerQueueHistogram;
+	};
+}
@@ -0,0 +1,245 @@
+#include "virtualInstrument.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "config.h"
+#include "midiTypes.h"
+
+#include "../asBase/logging.h"
+
+namespace asLib
+{
+constexpr double g_twoPi = 6.283185307179586;
+constexpr float g_voiceAmplitude = 0.5f;		// at full velocity
+constexpr float g_voiceSilence = 0.00001f;		// voices are removed once their release has decayed below this level
+constexpr int g_maxHarmonics = 8;
+
+namespace
+{
+	template<typename T> void store(uint8_t* _dst, const T _value)
+	{
+		::memcpy(_dst, &_value, sizeof(T));
+	}
+
+	void fromFloat(uint8_t* _dst, const SampleFormat _format, float _value)
+	{
+		_value = std::max(-1.0f, std::min(1.0f, _value));
+
+		switch (_format)
+		{
+		case SampleFormatInt8:		store(_dst, static_cast<int8_t>(std::lround(_value * 127.0f)));	break;
+		case SampleFormatUInt8:		store(_dst, static_cast<uint8_t>(std::lround(_value * 127.0f) + 128));	break;
+		case SampleFormatInt16:		store(_dst, static_cast<int16_t>(std::lround(_value * 32767.0f)));	break;
+		case SampleFormatInt24:
+			{
+				const auto value = static_cast<int32_t>(std::lround(_value * 8388607.0f));
+				_dst[0] = static_cast<uint8_t>(value);
+				_dst[1] = static_cast<uint8_t>(value >> 8);
+				_dst[2] = static_cast<uint8_t>(value >> 16);
+			}
+			break;
+		case SampleFormatInt32:		store(_dst, static_cast<int32_t>(std::llround(static_cast<double>(_value) * 2147483647.0)));	break;
+		case SampleFormatFloat32:	store(_dst, _value);	break;
+		}
+	}
+}
+
+VirtualInstrument::VirtualInstrument(const Config& _config)
+	: m_samplerate(static_cast<float>(_config.inputSamplerate))
+	, m_sampleFormat(bitCountToSampleFormat(_config.inputBits))
+	, m_format(toSampleFormat(m_sampleFormat))
+	, m_channelCount(static_cast<size_t>(std::max(1, _config.inputChannels)))
+	, m_blockSize(static_cast<size_t>(std::max(1, _config.inputBlockSize)))
+	, m_attackIncrement(_config.virtualAttack > 0.0f ? 1.0f / (_config.virtualAttack * m_samplerate) : 1.0f)
+	, m_releaseFactor(_config.virtualDecay > 0.0f ? std::pow(10.0f, -3.0f / (_config.virtualDecay * m_samplerate)) : 0.0f)	// -60 dB after the decay time
+	, m_noiseLevel(_config.virtualNoise)
+{
+	m_signal.resize(m_blockSize);
+	m_output.resize(m_blockSize * m_channelCount * getSampleSize(m_format));
+
+	LOG("Virtual instrument, samplerate " << m_samplerate << ", " << _config.inputBits << " bits, " << m_channelCount << " channels");
+}
+
+void VirtualInstrument::start(Callback _callback)
+{
+	m_callback = std::move(_callback);
+	m_running = true;
+}
+
+void VirtualInstrument::stop()
+{
+	m_running = false;
+}
+
+bool VirtualInstrument::pull()
+{
+	if(!m_running)
+		return false;
+
+	const uint64_t position = m_framePosition;
+	const auto end = position + m_blockSize;
+
+	{
+		std::lock_guard<std::mutex> lock(m_eventsMutex);
+
+		m_dueEvents.clear();
+
+		while(!m_events.empty() && m_events.begin()->first < end)
+		{
+			m_dueEvents.push_back(*m_events.begin());
+			m_events.erase(m_events.begin());
+		}
+	}
+
+	// render up to the next event, apply it and continue, events are sample accurate
+	size_t frame = 0;
+
+	for(const auto& e : m_dueEvents)
+	{
+		const auto eventFrame = static_cast<size_t>(e.first - position);
+
+		render(&m_signal[frame], eventFrame - frame);
+		frame = eventFrame;
+
+		processEvent(e.second);
+	}
+
+	render(&m_signal[frame], m_blockSize - frame);
+
+	const auto bytesPerSample = getSampleSize(m_format);
+	auto* out = &m_output[0];
+
+	for(size_t i=0; i<m_blockSize; ++i)
+	{
+		for(size_t c=0; c<m_channelCount; ++c, out += bytesPerSample)
+			fromFloat(out, m_format, m_signal[i] + noise());
+	}
+
+	m_framePosition = end;
+
+	if(!m_callback(&m_output[0], m_blockSize, static_cast<double>(position) / m_samplerate, false))
+		m_running = false;
+
+	return true;
+}
+
+double VirtualInstrument::getTime() const
+{
+	return static_cast<double>(m_framePosition) / m_samplerate;
+}
+
+void VirtualInstrument::send(const uint8_t _status, const uint8_t _data1, const uint8_t _data2, const double _time)
+{
+	const uint64_t now = m_framePosition;
+
+	auto position = _time > 0.0 ? static_cast<uint64_t>(std::llround(_time * m_samplerate)) : now;
+
+	if(position < now)
+	{
+		LOG_WARNING("MIDI event is " << (now - position) << " frames late");
+		position = now;
+	}
+
+	std::lock_guard<std::mutex> lock(m_eventsMutex);
+	m_events.insert(std::make_pair(position, Event{_status, _data1, _data2}));
+}
+
+void VirtualInstrument::processEvent(const Event& _event)
+{
+	const uint8_t channel = _event.status & 0x0f;
+
+	switch (_event.status & 0xf0)
+	{
+	case M_NOTEON:
+		if(_event.data2 > 0)
+			noteOn(channel, _event.data1, _event.data2);
+		else
+			noteOff(channel, _event.data1);
+		break;
+	case M_NOTEOFF:
+		noteOff(channel, _event.data1);
+		break;
+	case M_PROGRAMCHANGE:
+		m_programs[channel] = _event.data1;
+		break;
+	default:;
+	}
+}
+
+void VirtualInstrument::noteOn(const uint8_t _channel, const uint8_t _note, const uint8_t _velocity)
+{
+	noteOff(_channel, _note);
+
+	const auto frequency = 440.0 * std::pow(2.0, (static_cast<double>(_note) - 69.0) / 12.0);
+
+	// limit the harmonics to stay below nyquist
+	const auto harmonicCount = std::max(1, std::min(1 + m_programs[_channel] % g_maxHarmonics, static_cast<int>(m_samplerate * 0.5 / frequency)));
+
+	Voice v;
+	v.channel = _channel;
+	v.note = _note;
+	v.amplitude = g_voiceAmplitude * static_cast<float>(_velocity) / 127.0f;
+	v.phase = 0.0;
+	v.phaseIncrement = g_twoPi * frequency / m_samplerate;
+	v.harmonicCount = harmonicCount;
+	v.envelope = 0.0f;
+	v.released = false;
+
+	m_voices.push_back(v);
+}
+
+void VirtualInstrument::noteOff(const uint8_t _channel, const uint8_t _note)
+{
+	for(auto& v : m_voices)
+	{
+		if(v.channel == _channel && v.note == _note)
+			v.released = true;
+	}
+}
+
+void VirtualInstrument::render(float* _dst, const size_t _frameCount)
+{
+	std::fill(_dst, _dst + _frameCount, 0.0f);
+
+	for(auto& v : m_voices)
+	{
+		// 1/n amplitude per harmonic, normalized to not exceed the voice amplitude
+		float norm = 0.0f;
+		for(auto h=1; h<=v.harmonicCount; ++h)
+			norm += 1.0f / static_cast<float>(h);
+		const auto gain = v.amplitude / norm;
+
+		for(size_t i=0; i<_frameCount; ++i)
+		{
+			if(v.released)
+				v.envelope *= m_releaseFactor;
+			else
+				v.envelope = std::min(1.0f, v.envelope + m_attackIncrement);
+
+			float sample = 0.0f;
+			for(auto h=1; h<=v.harmonicCount; ++h)
+				sample += static_cast<float>(std::sin(v.phase * h)) / static_cast<float>(h);
+
+			_dst[i] += sample * gain * v.envelope;
+
+			v.phase += v.phaseIncrement;
+			if(v.phase >= g_twoPi)
+				v.phase -= g_twoPi;
+		}
+	}
+
+	m_voices.erase(std::remove_if(m_voices.begin(), m_voices.end(), [](const Voice& _v)
+	{
+		return _v.released && _v.envelope < g_voiceSilence;
+	}), m_voices.end());
+}
+
+float VirtualInstrument::noise()
+{
+	// linear congruential generator, the same session always produces the same noise
+	m_noiseState = m_noiseState * 1664525u + 1013904223u;
+	return static_cast<float>(static_cast<int32_t>(m_noiseState)) * (1.0f / 2147483648.0f) * m_noiseLevel;
+}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "audioSource.h"
+#include "midiSink.h"
+#include "sampleConverter.h"
+
+namespace asLib
+{
+	struct Config;
+
+	// Deterministic software instrument that replaces the audio input and the MIDI output. It renders a harmonic tone
+	// for every note, the program selects the number of harmonics. Audio is produced on demand via pull(), which makes
+	// a session run as fast as it can be processed and sample accurate, independent of any hardware
+	class VirtualInstrument : public AudioSource, public MidiSink
+	{
+	public:
+		explicit VirtualInstrument(const Config& _config);
+		VirtualInstrument(const VirtualInstrument&) = delete;
+
+		// AudioSource
+		void start(Callback _callback) override;
+		void stop() override;
+		bool pull() override;
+
+		double getTime() const override;
+		float getSamplerate() const override				{ return m_samplerate; }
+		unsigned long getSampleFormat() const override		{ return m_sampleFormat; }
+		size_t getChannelCount() const override				{ return m_channelCount; }
+
+		// MidiSink
+		void send(uint8_t _status, uint8_t _data1, uint8_t _data2, double _time) override;
+
+		VirtualInstrument& operator = (const VirtualInstrument&) = delete;
+
+	private:
+		struct Event
+		{
+			uint8_t status;
+			uint8_t data1;
+			uint8_t data2;
+		};
+
+		struct Voice
+		{
+			uint8_t channel;
+			uint8_t note;
+			float amplitude;
+			double phase;
+			double phaseIncrement;
+			int harmonicCount;
+			float envelope;
+			bool released;
+		};
+
+		void processEvent(const Event& _event);
+		void noteOn(uint8_t _channel, uint8_t _note, uint8_t _velocity);
+		void noteOff(uint8_t _channel, uint8_t _note);
+		void render(float* _dst, size_t _frameCount);
+		float noise();
+
+		const float m_samplerate;
+		const unsigned long m_sampleFormat;
+		const SampleFormat m_format;
+		const size_t m_channelCount;
+		const size_t m_blockSize;
+
+		const float m_attackIncrement;		// per frame
+		const float m_releaseFactor;		// per frame
+		const float m_noiseLevel;
+
+		Callback m_callback;
+		bool m_running = false;
+
+		std::atomic<uint64_t> m_framePosition{0};
+
+		std::multimap<uint64_t, Event> m_events;	// ordered by frame position, events at the same position keep their order
+		std::mutex m_eventsMutex;
+
+		std::vector<Voice> m_voices;
+		uint8_t m_programs[16] = {};		// per MIDI channel, all channels are mixed to all outputs
+		uint32_t m_noiseState = 1;
+
+		std::vector<std::pair<uint64_t, Event>> m_dueEvents;
+		std::vector<float> m_signal;
+		std::vector<uint8_t> m_output;
+	};
+}
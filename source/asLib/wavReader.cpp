@@ -0,0 +1,202 @@
+#include "wavReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "error.h"
+#include "wavWriter.h"
+
+#include "../portaudio/include/portaudio.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace asLib
+{
+WavReader::WavReader(const std::string& _filename) : m_filename(_filename)
+{
+	map();
+
+	try
+	{
+		parse();
+	}
+	catch(...)
+	{
+		unmap();
+		throw;
+	}
+}
+
+WavReader::~WavReader()
+{
+	unmap();
+}
+
+void WavReader::map()
+{
+#ifdef _WIN32
+	auto* file = CreateFileA(m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		throw Error(ErrFileIO, "Failed to open file " + m_filename);
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		throw Error(ErrFileFormat, "File is empty or cannot be read: " + m_filename);
+	}
+
+	auto* mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	const auto* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	if(!view)
+	{
+		if(mapping)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		throw Error(ErrFileIO, "Failed to map file " + m_filename);
+	}
+
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_mapping = static_cast<const uint8_t*>(view);
+	m_mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+	const auto fd = open(m_filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw Error(ErrFileIO, "Failed to open file " + m_filename);
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		throw Error(ErrFileFormat, "File is empty or cannot be read: " + m_filename);
+	}
+
+	auto* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// the mapping keeps its own reference to the file
+	close(fd);
+
+	if(view == MAP_FAILED)
+		throw Error(ErrFileIO, "Failed to map file " + m_filename);
+
+	m_mapping = static_cast<const uint8_t*>(view);
+	m_mappingSize = static_cast<size_t>(st.st_size);
+#endif
+}
+
+void WavReader::unmap()
+{
+	if(!m_mapping)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_mapping);
+	CloseHandle(m_mappingHandle);
+	CloseHandle(m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_mapping), m_mappingSize);
+#endif
+
+	m_mapping = nullptr;
+	m_mappingSize = 0;
+	m_data = nullptr;
+}
+
+void WavReader::parse()
+{
+	const auto isRiff = m_mappingSize >= sizeof(SWaveFormatHeader) && (memcmp(m_mapping, "RIFF", 4) == 0 || memcmp(m_mapping, "RF64", 4) == 0 || memcmp(m_mapping, "BW64", 4) == 0);
+
+	if(!isRiff || memcmp(m_mapping + 8, "WAVE", 4) != 0)
+		throw Error(ErrFileFormat, "Not a wave file: " + m_filename);
+
+	SWaveFormatChunkFormat fmt{};
+	auto hasFormat = false;
+	uint16_t formatTag = 0;
+
+	size_t dataOffset = 0;
+	size_t dataSize = 0;
+	uint64_t ds64DataSize = 0;
+
+	for(size_t pos = sizeof(SWaveFormatHeader); pos + sizeof(SWaveFormatChunkInfo) <= m_mappingSize;)
+	{
+		SWaveFormatChunkInfo chunk;
+		::memcpy(&chunk, m_mapping + pos, sizeof(chunk));
+
+		const auto chunkData = pos + sizeof(SWaveFormatChunkInfo);
+		const auto chunkSize = std::min(static_cast<size_t>(chunk.chunkSize), m_mappingSize - chunkData);
+
+		if(memcmp(chunk.chunkName, "ds64", 4) == 0 && chunkSize >= sizeof(SWaveFormatChunkDs64))
+		{
+			// RF64: 64 bit size of the data chunk, its 32 bit size is 0xffffffff
+			SWaveFormatChunkDs64 ds64;
+			::memcpy(&ds64, m_mapping + chunkData, sizeof(ds64));
+			ds64DataSize = ds64.data_size;
+		}
+		else if(memcmp(chunk.chunkName, "fmt ", 4) == 0 && chunkSize >= sizeof(fmt))
+		{
+			::memcpy(&fmt, m_mapping + chunkData, sizeof(fmt));
+			formatTag = fmt.wave_type;
+
+			// WAVE_FORMAT_EXTENSIBLE: the actual format is stored in the first two bytes of the sub format GUID
+			if(formatTag == eFormat_EXTENSIBLE && chunkSize >= sizeof(fmt) + 10)
+				::memcpy(&formatTag, m_mapping + chunkData + sizeof(fmt) + 8, sizeof(formatTag));
+
+			hasFormat = true;
+		}
+		else if(memcmp(chunk.chunkName, "data", 4) == 0)
+		{
+			// some writers do not update the size if a recording is interrupted, use what is there
+			dataOffset = chunkData;
+
+			if(chunk.chunkSize == 0xffffffff && ds64DataSize)
+				dataSize = static_cast<size_t>(std::min(ds64DataSize, static_cast<uint64_t>(m_mappingSize - chunkData)));
+			else
+				dataSize = (chunk.chunkSize == 0 || chunk.chunkSize == 0xffffffff) ? m_mappingSize - chunkData : chunkSize;
+			break;
+		}
+
+		// chunks are padded to an even size
+		pos = chunkData + chunkSize + (chunkSize & 1);
+	}
+
+	if(!hasFormat || !dataOffset)
+		throw Error(ErrFileFormat, "Wave file has no format or data chunk: " + m_filename);
+
+	if(formatTag == eFormat_IEEE_FLOAT && fmt.bits_per_sample == 32)
+		m_sampleFormat = paFloat32;
+	else if(formatTag == eFormat_PCM && fmt.bits_per_sample == 8)
+		m_sampleFormat = paUInt8;
+	else if(formatTag == eFormat_PCM && fmt.bits_per_sample == 16)
+		m_sampleFormat = paInt16;
+	else if(formatTag == eFormat_PCM && fmt.bits_per_sample == 24)
+		m_sampleFormat = paInt24;
+	else if(formatTag == eFormat_PCM && fmt.bits_per_sample == 32)
+		m_sampleFormat = paInt32;
+	else
+	{
+		std::stringstream ss; ss << "Unsupported wave format " << formatTag << " with " << fmt.bits_per_sample << " bits in file " << m_filename;
+		throw Error(ErrFileFormat, ss);
+	}
+
+	if(fmt.num_channels == 0 || fmt.sample_rate == 0)
+		throw Error(ErrFileFormat, "Invalid wave format in file " + m_filename);
+
+	m_channelCount = fmt.num_channels;
+	m_samplerate = static_cast<float>(fmt.sample_rate);
+	m_bytesPerFrame = m_channelCount * (fmt.bits_per_sample >> 3);
+	m_data = m_mapping + dataOffset;
+	m_frameCount = dataSize / m_bytesPerFrame;
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace asLib
+{
+	// Read-only access to the audio data of a wave file. The file is memory mapped, audio data is not copied
+	// but paged in on demand, which makes it possible to process very large files from multiple threads
+	class WavReader
+	{
+	public:
+		// throws if the file cannot be opened or if the format is not supported
+		explicit WavReader(const std::string& _filename);
+		WavReader(const WavReader&) = delete;
+		~WavReader();
+
+		const uint8_t* getData() const				{ return m_data; }
+		const uint8_t* getFrame(size_t _frame) const	{ return m_data + _frame * m_bytesPerFrame; }
+		size_t getFrameCount() const				{ return m_frameCount; }
+		size_t getBytesPerFrame() const				{ return m_bytesPerFrame; }
+		size_t getChannelCount() const				{ return m_channelCount; }
+		float getSamplerate() const					{ return m_samplerate; }
+		unsigned long getSampleFormat() const		{ return m_sampleFormat; }	// PortAudio sample format
+		const std::string& getFilename() const		{ return m_filename; }
+
+		WavReader& operator = (const WavReader&) = delete;
+
+	private:
+		void map();
+		void unmap();
+		void parse();
+
+		const std::string m_filename;
+
+		const uint8_t* m_mapping = nullptr;
+		size_t m_mappingSize = 0;
+#ifdef _WIN32
+		void* m_fileHandle = nullptr;
+		void* m_mappingHandle = nullptr;
+#endif
+
+		const uint8_t* m_data = nullptr;
+		size_t m_frameCount = 0;
+		size_t m_bytesPerFrame = 0;
+		size_t m_channelCount = 0;
+		float m_samplerate = 0.0f;
+		unsigned long m_sampleFormat = 0;
+	};
+}
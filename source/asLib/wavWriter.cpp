@@ -1,126 +1,175 @@
 #include "wavWriter.h"
 
+#include "fileWriter.h"
+
 #include "../asBase/logging.h"
 
+#include <algorithm>
 #include <cstring>
 #include <map>
+#include <memory>
 #include <cassert>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace asLib
 {
-bool WavWriter::write(const std::string & _filename, const std::vector<uint8_t>& data, int _bitsPerSample, bool _isFloat, int _channelCount, int _samplerate, std::vector<CuePoint>* _cuePoints /*= nullptr*/)
+constexpr size_t g_moveBufferSize = 1024 * 1024;
+constexpr size_t g_fileBufferSize = 1024 * 1024;	// streaming mode, recorded blocks are small
+constexpr uint64_t g_maxRiffSize = 0xffffffff;
+
+
+static bool seek(FILE* _handle, const uint64_t _offset)
 {
-	FILE* handle = fopen(_filename.c_str(), "wb");
+#ifdef _WIN32
+	return _fseeki64(_handle, static_cast<__int64>(_offset), SEEK_SET) == 0;
+#else
+	return fseeko(_handle, static_cast<off_t>(_offset), SEEK_SET) == 0;
+#endif
+}
 
-	if (!handle)
-	{
-		LOG("Failed to open file for writing: " << _filename);
-		return false;
-	}
+static bool truncate(FILE* _handle, const uint64_t _size)
+{
+	fflush(_handle);
+#ifdef _WIN32
+	return _chsize_s(_fileno(_handle), static_cast<__int64>(_size)) == 0;
+#else
+	return ftruncate(fileno(_handle), static_cast<off_t>(_size)) == 0;
+#endif
+}
 
-	SWaveFormatHeader header;
+template<typename T> static void append(std::vector<uint8_t>& _buffer, const T& _value)
+{
+	const auto* data = reinterpret_cast<const uint8_t*>(&_value);
+	_buffer.insert(_buffer.end(), data, data + sizeof(T));
+}
+
+static void appendChunkInfo(std::vector<uint8_t>& _buffer, const char* _name, const uint32_t _size)
+{
+	SWaveFormatChunkInfo chunkInfo;
+	::memcpy(chunkInfo.chunkName, _name, 4);
+	chunkInfo.chunkSize = _size;
+	append(_buffer, chunkInfo);
+}
 
-	header.str_riff[0] = 'R';
-	header.str_riff[1] = 'I';
-	header.str_riff[2] = 'F';
-	header.str_riff[3] = 'F';
+size_t WavWriter::createHeader(std::vector<uint8_t>& _header, const int _bitsPerSample, const bool _isFloat, const int _channelCount, const int _samplerate, const uint64_t _dataSize, const uint64_t _trailingSize, const bool _reserveDs64)
+{
+	const auto bytesPerFrame = static_cast<uint32_t>((_bitsPerSample >> 3) * _channelCount);
+	const auto extensible = _channelCount > 2 || _bitsPerSample > 16;
 
-	header.str_wave[0] = 'W';
-	header.str_wave[1] = 'A';
-	header.str_wave[2] = 'V';
-	header.str_wave[3] = 'E';
+	const auto formatSize = sizeof(SWaveFormatChunkFormat) + (extensible ? sizeof(SWaveFormatChunkFormatExtension) : 0);
+	const auto ds64Size = sizeof(SWaveFormatChunkInfo) + sizeof(SWaveFormatChunkDs64);
 
-	const size_t dataSize = data.size();
+	auto headerSize = sizeof(SWaveFormatHeader) + sizeof(SWaveFormatChunkInfo) + formatSize + sizeof(SWaveFormatChunkInfo);
 
-	header.file_size = 
-		sizeof(SWaveFormatHeader) + 
-		sizeof(SWaveFormatChunkInfo) + 
-		sizeof(SWaveFormatChunkFormat) +
-		sizeof(SWaveFormatChunkInfo) +
-		dataSize +
-		- 8;
+	// chunks are padded to an even size
+	const auto fileSizeWithoutHeader = _dataSize + (_dataSize & 1) + _trailingSize;
 
-	fwrite(&header, 1, sizeof(header), handle);
+	const auto rf64 = _dataSize > g_maxRiffSize || headerSize + ds64Size + fileSizeWithoutHeader - 8 > g_maxRiffSize;
 
-	// write format
-	SWaveFormatChunkInfo chunkInfo;
+	if(rf64 || _reserveDs64)
+		headerSize += ds64Size;
 
-	chunkInfo.chunkName[0] = 'f';
-	chunkInfo.chunkName[1] = 'm';
-	chunkInfo.chunkName[2] = 't';
-	chunkInfo.chunkName[3] = ' ';
+	const uint64_t riffSize = headerSize + fileSizeWithoutHeader - 8;
 
-	chunkInfo.chunkSize = sizeof(SWaveFormatChunkFormat);
+	_header.clear();
+	_header.reserve(headerSize);
 
-	fwrite(&chunkInfo, 1, sizeof(chunkInfo), handle);
+	SWaveFormatHeader header;
+	::memcpy(header.str_riff, rf64 ? "RF64" : "RIFF", 4);
+	header.file_size = rf64 ? static_cast<uint32_t>(g_maxRiffSize) : static_cast<uint32_t>(riffSize);
+	::memcpy(header.str_wave, "WAVE", 4);
+
+	append(_header, header);
+
+	if(rf64 || _reserveDs64)
+	{
+		SWaveFormatChunkDs64 ds64{};
+
+		if(rf64)
+		{
+			ds64.riff_size = riffSize;
+			ds64.data_size = _dataSize;
+			ds64.sample_count = _dataSize / bytesPerFrame;
+		}
+
+		appendChunkInfo(_header, rf64 ? "ds64" : "JUNK", sizeof(ds64));
+		append(_header, ds64);
+	}
+
+	appendChunkInfo(_header, "fmt ", static_cast<uint32_t>(formatSize));
 
 	SWaveFormatChunkFormat fmt;
 
-	const auto bytesPerSample = _bitsPerSample >> 3;
-	const auto bytesPerFrame = bytesPerSample * _channelCount;
+	fmt.bits_per_sample = static_cast<uint16_t>(_bitsPerSample);
+	fmt.block_alignment = static_cast<uint16_t>(bytesPerFrame);
+	fmt.bytes_per_sec = static_cast<uint32_t>(_samplerate) * bytesPerFrame;
+	fmt.num_channels = static_cast<uint16_t>(_channelCount);
+	fmt.sample_rate = static_cast<uint32_t>(_samplerate);
+	fmt.wave_type = extensible ? eFormat_EXTENSIBLE : (_isFloat ? eFormat_IEEE_FLOAT : eFormat_PCM);
 
-	fmt.bits_per_sample = _bitsPerSample;
-	fmt.block_alignment = bytesPerFrame;
-	fmt.bytes_per_sec = _samplerate * bytesPerFrame;
-	fmt.num_channels = (uint16_t)_channelCount;
-	fmt.sample_rate = (unsigned int)_samplerate;
-	fmt.wave_type = _isFloat ? eFormat_IEEE_FLOAT : eFormat_PCM;
+	append(_header, fmt);
 
-	fwrite(&fmt, 1, sizeof(fmt), handle);
+	if(extensible)
+	{
+		// KSDATAFORMAT_SUBTYPE_PCM / KSDATAFORMAT_SUBTYPE_IEEE_FLOAT
+		const uint8_t subFormat[16] = {static_cast<uint8_t>(_isFloat ? eFormat_IEEE_FLOAT : eFormat_PCM), 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71};
 
-	// write data
-	chunkInfo.chunkName[0] = 'd';
-	chunkInfo.chunkName[1] = 'a';
-	chunkInfo.chunkName[2] = 't';
-	chunkInfo.chunkName[3] = 'a';
+		SWaveFormatChunkFormatExtension extension;
+		extension.extension_size = sizeof(SWaveFormatChunkFormatExtension) - sizeof(extension.extension_size);
+		extension.valid_bits_per_sample = static_cast<uint16_t>(_bitsPerSample);
+		extension.channel_mask = _channelCount == 1 ? 0x4 : (_channelCount == 2 ? 0x3 : 0);	// center, left + right, unspecified
+		::memcpy(extension.sub_format, subFormat, sizeof(subFormat));
 
-	chunkInfo.chunkSize = static_cast<unsigned int>(data.size());
+		append(_header, extension);
+	}
+
+	appendChunkInfo(_header, "data", rf64 ? static_cast<uint32_t>(g_maxRiffSize) : static_cast<uint32_t>(_dataSize));
+
+	assert(_header.size() == headerSize);
+
+	return headerSize;
+}
 
-	fwrite(&chunkInfo, 1, sizeof(chunkInfo), handle);
+bool WavWriter::write(const std::string & _filename, const void* _data, const size_t _dataSize, int _bitsPerSample, bool _isFloat, int _channelCount, int _samplerate, std::vector<CuePoint>* _cuePoints /*= nullptr*/, const FileIO _io/* = FileIOStdio*/, const FileWriter::Completion& _onComplete/* = nullptr*/)
+{
+	// everything that follows the audio data: padding and cue points
+	std::vector<uint8_t> trailer;
 
-	fwrite(&data[0], 1, data.size(), handle);
+	if(_dataSize & 1)
+		trailer.push_back(0);
 
 	if(_cuePoints && !_cuePoints->empty())
 	{
 		// write cue points
-		chunkInfo.chunkName[0] = 'c';
-		chunkInfo.chunkName[1] = 'u';
-		chunkInfo.chunkName[2] = 'e';
-		chunkInfo.chunkName[3] = ' ';
-		chunkInfo.chunkSize = sizeof(SWaveFormatChunkCue) + sizeof(SWaveFormatChunkCuePoint) * _cuePoints->size();
-
-		header.file_size += sizeof(SWaveFormatChunkInfo) + chunkInfo.chunkSize;
-
-		fwrite(&chunkInfo, 1, sizeof(chunkInfo), handle);
+		appendChunkInfo(trailer, "cue ", static_cast<uint32_t>(sizeof(SWaveFormatChunkCue) + sizeof(SWaveFormatChunkCuePoint) * _cuePoints->size()));
 
 		SWaveFormatChunkCue chunkCue;
-		chunkCue.cuePointCount = _cuePoints->size();
+		chunkCue.cuePointCount = static_cast<uint32_t>(_cuePoints->size());
 
-		fwrite(&chunkCue, 1, sizeof(chunkCue), handle);
+		append(trailer, chunkCue);
 
 		for (size_t i = 0; i < chunkCue.cuePointCount; ++i)
 		{
 			SWaveFormatChunkCuePoint point;
-			point.cueId = i;
+			point.cueId = static_cast<uint32_t>(i);
 			point.blockStart = 0;
 			point.chunkStart = 0;
 			point.dataChunkId[0] = 'd';
 			point.dataChunkId[1] = 'a';
 			point.dataChunkId[2] = 't';
 			point.dataChunkId[3] = 'a';
-			point.sampleOffset = (*_cuePoints)[i].sampleOffset;
+			point.sampleOffset = static_cast<uint32_t>((*_cuePoints)[i].sampleOffset);
 			point.playOrderPosition = point.sampleOffset;
 
-			fwrite(&point, 1, sizeof(point), handle);
+			append(trailer, point);
 		}
 
 		// write cue point labels
-		chunkInfo.chunkName[0] = 'L';
-		chunkInfo.chunkName[1] = 'I';
-		chunkInfo.chunkName[2] = 'S';
-		chunkInfo.chunkName[3] = 'T';
-		chunkInfo.chunkSize = sizeof(SWaveFormatChunkList);
-
 		SWaveFormatChunkList adtl;
 		adtl.typeId[0] = 'a';
 		adtl.typeId[1] = 'd';
@@ -133,45 +182,204 @@ bool WavWriter::write(const std::string & _filename, const std::vector<uint8_t>&
 		{
 			const CuePoint& cuePoint = (*_cuePoints)[i];
 
-			SWaveFormatChunkInfo subChunkInfo;
-
-			subChunkInfo.chunkName[0] = 'l';
-			subChunkInfo.chunkName[1] = 'a';
-			subChunkInfo.chunkName[2] = 'b';
-			subChunkInfo.chunkName[3] = 'l';
+			const auto labelSize = static_cast<uint32_t>(sizeof(SWaveFormatChunkLabel) + cuePoint.name.size() + 1);
 
-			subChunkInfo.chunkSize = sizeof(SWaveFormatChunkLabel) + cuePoint.name.size() + 1;
+			appendChunkInfo(buffer, "labl", labelSize);
 
 			SWaveFormatChunkLabel label;
-			label.cuePointId = i;
+			label.cuePointId = static_cast<uint32_t>(i);
 
-			size_t writePos = buffer.size();
-			const size_t totalCuePointSize = sizeof(SWaveFormatChunkInfo) + ((subChunkInfo.chunkSize + 1) & ~1);
-			buffer.resize(writePos + totalCuePointSize, 0); 
+			append(buffer, label);
+			buffer.insert(buffer.end(), cuePoint.name.begin(), cuePoint.name.end());
 
-			::memcpy(&buffer[writePos], &subChunkInfo, sizeof(subChunkInfo));
-			writePos += sizeof(subChunkInfo);
-			::memcpy(&buffer[writePos], &label, sizeof(label));
-			writePos += sizeof(label);
-			::memcpy(&buffer[writePos], cuePoint.name.c_str(), cuePoint.name.size());
+			// zero terminated, padded to an even size
+			buffer.resize(buffer.size() + 1 + (labelSize & 1), 0);
 		}
 
-		chunkInfo.chunkSize += buffer.size();
+		appendChunkInfo(trailer, "LIST", static_cast<uint32_t>(sizeof(adtl) + buffer.size()));
+		append(trailer, adtl);
+		trailer.insert(trailer.end(), buffer.begin(), buffer.end());
+	}
+
+	std::vector<uint8_t> header;
+	createHeader(header, _bitsPerSample, _isFloat, _channelCount, _samplerate, _dataSize, trailer.size() - (_dataSize & 1), false);
 
-		fwrite(&chunkInfo, 1, sizeof(chunkInfo), handle);
-		fwrite(&adtl, 1, sizeof(adtl), handle);
-		fwrite(&buffer[0], 1, buffer.size(), handle);
+	if(_onComplete && FileWriter::isAsync(_io))
+	{
+		// header and trailer need to outlive this call
+		auto chunks = std::make_shared<std::pair<std::vector<uint8_t>, std::vector<uint8_t>>>(std::move(header), std::move(trailer));
+
+		FileWriter::writeAsync(_filename, {{chunks->first.data(), chunks->first.size()}, {_data, _dataSize}, {chunks->second.data(), chunks->second.size()}}, [chunks, _onComplete](const bool _success)
+		{
+			_onComplete(_success);
+		});
 
-		header.file_size += sizeof(SWaveFormatChunkInfo) + chunkInfo.chunkSize;
+		return true;
 	}
 
-	fseek(handle, 0, SEEK_SET);
+	const auto res = FileWriter::write(_filename, {{header.data(), header.size()}, {_data, _dataSize}, {trailer.data(), trailer.size()}}, _io);
+
+	if(!res)
+		LOG_ERROR("Failed to write file " << _filename);
+
+	return res;
+}
+
+WavWriter::~WavWriter()
+{
+	if(isOpen())
+		finalize();
+}
+
+bool WavWriter::open(const std::string& _filename, const int _bitsPerSample, const bool _isFloat, const int _channelCount, const int _samplerate)
+{
+	close();
+
+	// the file gets its final name once it is complete
+	m_tempFilename = FileWriter::getTempFilename(_filename);
+
+	m_handle = fopen(m_tempFilename.c_str(), "w+b");
+
+	if (!m_handle)
+	{
+		LOG_ERROR("Failed to open file for writing: " << _filename);
+		return false;
+	}
 
-	fwrite(&header, 1, sizeof(header), handle);
+	m_fileBuffer.resize(g_fileBufferSize);
+	setvbuf(m_handle, m_fileBuffer.data(), _IOFBF, m_fileBuffer.size());
 
-	fclose(handle);
+	m_filename = _filename;
+	m_bitsPerSample = _bitsPerSample;
+	m_isFloat = _isFloat;
+	m_channelCount = _channelCount;
+	m_samplerate = _samplerate;
 
+	m_bytesPerFrame = static_cast<size_t>((_bitsPerSample >> 3) * _channelCount);
+	m_frameCount = 0;
+
+	// the size of the header does not change when the file grows beyond 4 GiB, a JUNK chunk is replaced by ds64
+	std::vector<uint8_t> header;
+	m_dataOffset = createHeader(header, m_bitsPerSample, m_isFloat, m_channelCount, m_samplerate, 0, 0, true);
+
+	return writeHeader(0);
+}
+
+bool WavWriter::appendFrames(const void* _data, const size_t _frameCount)
+{
+	if(!isOpen())
+		return false;
+
+	const auto byteCount = _frameCount * m_bytesPerFrame;
+
+	if(fwrite(_data, 1, byteCount, m_handle) != byteCount)
+	{
+		LOG_ERROR("Failed to write to file " << m_filename);
+		return false;
+	}
+
+	m_frameCount += _frameCount;
 	return true;
 }
 
-}
\ No newline at end of file
+bool WavWriter::finalize(size_t _firstFrame, size_t _frameCount)
+{
+	if(!isOpen())
+		return false;
+
+	_firstFrame = std::min(_firstFrame, m_frameCount);
+	_frameCount = std::min(_frameCount, m_frameCount - _firstFrame);
+
+	if(!_frameCount)
+	{
+		discard();
+		return true;
+	}
+
+	const auto dataSize = _frameCount * m_bytesPerFrame;
+
+	// move the retained data to the front, in chunks to keep memory usage bounded
+	if(_firstFrame > 0)
+	{
+		const auto srcOffset = m_dataOffset + _firstFrame * m_bytesPerFrame;
+
+		std::vector<uint8_t> buffer(std::min(g_moveBufferSize, dataSize));
+
+		for(size_t done = 0; done < dataSize;)
+		{
+			const auto size = std::min(buffer.size(), dataSize - done);
+
+			if(!seek(m_handle, srcOffset + done) || fread(&buffer[0], 1, size, m_handle) != size ||
+				!seek(m_handle, m_dataOffset + done) || fwrite(&buffer[0], 1, size, m_handle) != size)
+			{
+				LOG_ERROR("Failed to trim file " << m_filename);
+				discard();
+				return false;
+			}
+
+			done += size;
+		}
+	}
+
+	const auto fileSize = m_dataOffset + dataSize;
+
+	if(fileSize < m_dataOffset + m_frameCount * m_bytesPerFrame && !truncate(m_handle, fileSize))
+	{
+		LOG_ERROR("Failed to truncate file " << m_filename);
+		discard();
+		return false;
+	}
+
+	m_frameCount = _frameCount;
+
+	// pad the data chunk to an even size
+	auto res = writeHeader(dataSize) && (!(dataSize & 1) || fputc(0, m_handle) != EOF) && FileWriter::syncFile(m_handle);
+
+	res = close() && res;
+
+	if(!res)
+	{
+		::remove(m_tempFilename.c_str());
+		return false;
+	}
+
+	return FileWriter::replaceFile(m_tempFilename, m_filename);
+}
+
+void WavWriter::discard()
+{
+	if(!isOpen())
+		return;
+
+	close();
+	::remove(m_tempFilename.c_str());
+}
+
+bool WavWriter::writeHeader(const uint64_t _dataSize)
+{
+	std::vector<uint8_t> header;
+	createHeader(header, m_bitsPerSample, m_isFloat, m_channelCount, m_samplerate, _dataSize, 0, true);
+
+	// header is written in front of the data that might already be there, return to the end afterwards
+	const auto res =
+		seek(m_handle, 0) &&
+		fwrite(header.data(), 1, header.size(), m_handle) == header.size() &&
+		seek(m_handle, m_dataOffset + _dataSize);
+
+	if(!res)
+		LOG_ERROR("Failed to write header of file " << m_filename);
+
+	return res;
+}
+
+bool WavWriter::close()
+{
+	if(!m_handle)
+		return true;
+
+	const auto res = fclose(m_handle) == 0;
+	m_handle = nullptr;
+	return res;
+}
+
+}
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdio>
 #include <vector>
 #include <string>
 
+#include "fileWriter.h"
+
 namespace asLib
 {
 // TODO: gcc and others
@@ -31,6 +34,22 @@ namespace asLib
 		uint16_t		block_alignment;		// bytes, that must be sent at a single time
 		uint16_t		bits_per_sample;		// bits per sample
 	};
+
+	struct SWaveFormatChunkFormatExtension		// follows SWaveFormatChunkFormat if wave_type is EXTENSIBLE, size = 40 (0x28) in total
+	{
+		uint16_t		extension_size;			// 22
+		uint16_t		valid_bits_per_sample;	// bits per sample that are actually used
+		uint32_t		channel_mask;			// speaker positions, 0 = unspecified
+		uint8_t			sub_format[16];			// GUID, the first two bytes are the format (PCM, IEEE_FLOAT)
+	};
+
+	struct SWaveFormatChunkDs64					// "ds64", RF64 only, size = 28 (0x1c). Written as "JUNK" if the file does not need it
+	{
+		uint64_t		riff_size;				// 64 bit version of SWaveFormatHeader::file_size, which is set to 0xffffffff
+		uint64_t		data_size;				// 64 bit size of the data chunk, its 32 bit size is set to 0xffffffff
+		uint64_t		sample_count;			// number of frames
+		uint32_t		table_length;			// number of 64 bit sizes of other chunks that follow, always 0
+	};
 	struct SWaveFormatChunkCue
 	{
 		uint32_t		cuePointCount;				// number of cue points in list
@@ -101,7 +120,8 @@ namespace asLib
 		eFormat_OLIADPCM					= 0x1001,
 		eFormat_OLICELP						= 0x1002,
 		eFormat_OLISBC						= 0x1003,
-		eFormat_OLIOPR						= 0x1004
+		eFormat_OLIOPR						= 0x1004,
+		eFormat_EXTENSIBLE					= 0xfffe
 	};
 
 	struct CuePoint
@@ -128,6 +148,57 @@ namespace asLib
 	class WavWriter
 	{
 	public:
-		static bool write(const std::string& _filename, const std::vector<uint8_t>& data, int bitsPerSample, bool isFloat, int _channelCount, int _samplerate, std::vector<CuePoint>* _cuePoints = nullptr);
+		// Files that exceed the 4 GiB limit of RIFF are written as RF64. WAVE_FORMAT_EXTENSIBLE is used for more than
+		// two channels or more than 16 bits.
+		// If _io is asynchronous and _onComplete is given, the write is only queued and _onComplete reports the result,
+		// _data needs to stay valid until then
+		static bool write(const std::string& _filename, const void* _data, size_t _dataSize, int bitsPerSample, bool isFloat, int _channelCount, int _samplerate, std::vector<CuePoint>* _cuePoints = nullptr, FileIO _io = FileIOStdio, const FileWriter::Completion& _onComplete = nullptr);
+
+		// creates everything in front of the audio data. _reserveDs64 adds the ds64 chunk as JUNK even if the file does not need it
+		// yet, to be able to convert it to RF64 in place. Returns the size of the header, which is the offset of the audio data
+		static size_t createHeader(std::vector<uint8_t>& _header, int _bitsPerSample, bool _isFloat, int _channelCount, int _samplerate, uint64_t _dataSize, uint64_t _trailingSize, bool _reserveDs64);
+
+		// Incremental writing: open() writes a preliminary header, audio data is appended while it is recorded and
+		// finalize() patches the header. Memory usage is independent of the length of the recording. The file is written
+		// under a temporary name until finalize() has completed
+		WavWriter() = default;
+		WavWriter(const WavWriter&) = delete;
+		~WavWriter();
+
+		bool open(const std::string& _filename, int _bitsPerSample, bool _isFloat, int _channelCount, int _samplerate);
+		bool appendFrames(const void* _data, size_t _frameCount);
+
+		// keeps only the frames in range [_firstFrame, _firstFrame + _frameCount), the file is deleted if no frames remain
+		bool finalize(size_t _firstFrame, size_t _frameCount);
+		bool finalize()							{ return finalize(0, m_frameCount); }
+
+		// closes and deletes the file
+		void discard();
+
+		bool isOpen() const						{ return m_handle != nullptr; }
+		size_t getFrameCount() const			{ return m_frameCount; }
+		const std::string& getFilename() const	{ return m_filename; }
+		size_t getDataOffset() const			{ return m_dataOffset; }
+		uint64_t getDataSize() const			{ return static_cast<uint64_t>(m_frameCount) * m_bytesPerFrame; }
+
+		WavWriter& operator = (const WavWriter&) = delete;
+
+	private:
+		bool writeHeader(uint64_t _dataSize);
+		bool close();
+
+		FILE* m_handle = nullptr;
+		std::string m_filename;
+		std::string m_tempFilename;
+		std::vector<char> m_fileBuffer;
+		size_t m_dataOffset = 0;
+
+		int m_bitsPerSample = 0;
+		bool m_isFloat = false;
+		int m_channelCount = 0;
+		int m_samplerate = 0;
+
+		size_t m_bytesPerFrame = 0;
+		size_t m_frameCount = 0;
 	};
 };